@@ -1,8 +1,8 @@
 #include "buffer.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <numeric>
 #include <ostream>
 #include <utility>
 
@@ -31,12 +31,6 @@ namespace AdHoc {
 		}
 	}
 
-	char
-	Buffer::CStringFragment::operator[](size_t x) const
-	{
-		return buf[x];
-	}
-
 	size_t
 	Buffer::CStringFragment::length() const
 	{
@@ -79,10 +73,16 @@ namespace AdHoc {
 		return buf;
 	}
 
-	char
-	Buffer::StringFragment::operator[](size_t x) const
+	void
+	Buffer::StringFragment::append(const char * str, size_t len)
 	{
-		return buf[x];
+		buf.append(str, len);
+	}
+
+	void
+	Buffer::StringFragment::reserve(size_t len)
+	{
+		buf.reserve(len);
 	}
 
 	//
@@ -109,10 +109,10 @@ namespace AdHoc {
 	{
 		if (str && *str) {
 			if (h == Copy) {
-				content.push_back(std::make_shared<StringFragment>(str));
+				push(std::make_shared<StringFragment>(str));
 			}
 			else {
-				content.push_back(std::make_shared<CStringFragment>(str, h));
+				push(std::make_shared<CStringFragment>(str, h));
 			}
 		}
 		return *this;
@@ -123,10 +123,10 @@ namespace AdHoc {
 	{
 		if (str && *str) {
 			if (h == Copy) {
-				content.push_back(std::make_shared<StringFragment>(str));
+				push(std::make_shared<StringFragment>(str));
 			}
 			else {
-				content.push_back(std::make_shared<CStringFragment>(str, h));
+				push(std::make_shared<CStringFragment>(str, h));
 			}
 		}
 		return *this;
@@ -136,7 +136,16 @@ namespace AdHoc {
 	Buffer::append(const std::string & str)
 	{
 		if (!str.empty()) {
-			content.push_back(std::make_shared<StringFragment>(str));
+			push(std::make_shared<StringFragment>(str));
+		}
+		return *this;
+	}
+
+	Buffer &
+	Buffer::append(std::string && str)
+	{
+		if (!str.empty()) {
+			push(std::make_shared<StringFragment>(std::move(str)));
 		}
 		return *this;
 	}
@@ -160,7 +169,7 @@ namespace AdHoc {
 		const auto len = vasprintf(&frag, fmt, args);
 #pragma GCC diagnostic pop
 		if (len > 0) {
-			content.push_back(std::make_shared<CStringFragment>(frag, Free, len));
+			push(std::make_shared<CStringFragment>(frag, Free, static_cast<size_t>(len)));
 		}
 		else {
 			// NOLINTNEXTLINE(hicpp-no-malloc)
@@ -176,10 +185,34 @@ namespace AdHoc {
 		return *this;
 	}
 
+	void
+	Buffer::push(FragmentPtr f)
+	{
+		fragmentData.push_back(f->c_str());
+		fragmentEnd.push_back(length() + f->length());
+		content.push_back(std::move(f));
+	}
+
+	void
+	Buffer::reset(FragmentPtr f) const
+	{
+		fragmentData = {f->c_str()};
+		fragmentEnd = {f->length()};
+		content = {std::move(f)};
+	}
+
+	size_t
+	Buffer::fragmentStart(size_t f) const
+	{
+		return f ? fragmentEnd[f - 1] : 0;
+	}
+
 	Buffer &
 	Buffer::clear()
 	{
 		content.clear();
+		fragmentData.clear();
+		fragmentEnd.clear();
 		return *this;
 	}
 
@@ -192,18 +225,25 @@ namespace AdHoc {
 	void
 	Buffer::writeto(char * buf, size_t bufSize, size_t off) const
 	{
-		auto f = content.begin();
-		while (f != content.end() && (*f)->length() < off) {
-			off -= (*f)->length();
-			++f;
-		}
-		while (f != content.end() && bufSize) {
-			for (size_t c = 0; bufSize && c < (*f)->length(); bufSize--) {
-				*buf++ = (**f)[c++];
-			}
-			++f;
+		buf[readto(buf, bufSize, off)] = '\0';
+	}
+
+	size_t
+	Buffer::readto(char * buf, size_t bufSize, size_t off) const
+	{
+		size_t total = 0;
+		// First fragment ending after off
+		auto f = static_cast<size_t>(
+				std::upper_bound(fragmentEnd.begin(), fragmentEnd.end(), off) - fragmentEnd.begin());
+		for (; f < fragmentEnd.size() && bufSize; ++f) {
+			const auto start = fragmentStart(f);
+			const auto skip = off > start ? off - start : 0;
+			const auto n = std::min(fragmentEnd[f] - start - skip, bufSize);
+			memcpy(buf + total, fragmentData[f] + skip, n);
+			total += n;
+			bufSize -= n;
 		}
-		*buf = '\0';
+		return total;
 	}
 
 	Buffer::operator std::string() const
@@ -211,8 +251,8 @@ namespace AdHoc {
 		if (content.size() > 1) {
 			std::string res;
 			res.reserve(length());
-			for (const auto & f : content) {
-				res.append(f->str());
+			for (size_t f = 0; f < fragmentData.size(); ++f) {
+				res.append(fragmentData[f], fragmentEnd[f] - fragmentStart(f));
 			}
 			return res;
 		}
@@ -235,7 +275,19 @@ namespace AdHoc {
 	Buffer::flatten() const
 	{
 		if (content.size() > 1) {
-			content = {std::make_shared<StringFragment>(str())};
+			// Extend the result of a previous flatten in place if it isn't shared with another Buffer
+			auto flat = content.front().use_count() == 1 ? std::dynamic_pointer_cast<StringFragment>(content.front())
+														 : nullptr;
+			size_t first = 1;
+			if (!flat) {
+				flat = std::make_shared<StringFragment>(std::string {});
+				flat->reserve(length());
+				first = 0;
+			}
+			for (auto f = first; f < fragmentData.size(); ++f) {
+				flat->append(fragmentData[f], fragmentEnd[f] - fragmentStart(f));
+			}
+			reset(std::move(flat));
 		}
 	}
 
@@ -248,22 +300,20 @@ namespace AdHoc {
 	size_t
 	Buffer::length() const
 	{
-		return std::accumulate(content.begin(), content.end(), 0U, [](auto && len, auto && c) {
-			return len + c->length();
-		});
+		return fragmentEnd.empty() ? 0 : fragmentEnd.back();
 	}
 
 	Buffer &
 	Buffer::operator=(const char * str)
 	{
-		content = {std::make_shared<StringFragment>(str)};
+		reset(std::make_shared<StringFragment>(str));
 		return *this;
 	}
 
 	Buffer &
 	Buffer::operator=(const std::string & str)
 	{
-		content = {std::make_shared<StringFragment>(str)};
+		reset(std::make_shared<StringFragment>(str));
 		return *this;
 	}
 
@@ -301,8 +351,8 @@ namespace AdHoc {
 std::ostream &
 std::operator<<(std::ostream & os, const AdHoc::Buffer & b)
 {
-	for (const auto & f : b.content) {
-		os.write(f->c_str(), static_cast<std::streamsize>(f->length()));
+	for (size_t f = 0; f < b.fragmentData.size(); ++f) {
+		os.write(b.fragmentData[f], static_cast<std::streamsize>(b.fragmentEnd[f] - b.fragmentStart(f)));
 	}
 	return os;
 }
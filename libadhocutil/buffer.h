@@ -72,12 +72,20 @@ namespace AdHoc {
 		operator const char *() const;
 
 		/**
-		 * Writes all elements in turn to the given buffer space, including a null terminator.
+		 * Writes all elements in turn to the given buffer space, followed by a null terminator.
 		 * @param buf Address of buffer to write into.
-		 * @param bufSize Maximum number of bytes to write.
+		 * @param bufSize Maximum number of bytes to write (excluding the null terminator).
 		 * @param off Effective starting position to copy from.
 		 */
 		void writeto(char * buf, size_t bufSize, size_t off) const;
+		/**
+		 * Copies elements in turn to the given buffer space, without a null terminator.
+		 * @param buf Address of buffer to write into.
+		 * @param bufSize Maximum number of bytes to write.
+		 * @param off Effective starting position to copy from.
+		 * @return The number of bytes written.
+		 */
+		size_t readto(char * buf, size_t bufSize, size_t off) const;
 		/** Write the Buffer to a std::ostream */
 		friend std::ostream & std::operator<<(std::ostream &, const Buffer &);
 
@@ -87,6 +95,8 @@ namespace AdHoc {
 		Buffer & append(char * str, CStringHandling h);
 		/** Append the given std::string to the end of the buffer. */
 		Buffer & append(const std::string & str);
+		/** Append the given std::string to the end of the buffer, taking ownership of its storage. */
+		Buffer & append(std::string && str);
 		/** Append the given printf style format string and arguments to the buffer. */
 		Buffer & appendf(const char * fmt, ...) __attribute__((format(printf, 2, 3)));
 		/** Append the given printf style format string and va_list to the buffer. */
@@ -122,6 +132,7 @@ namespace AdHoc {
 	private:
 		Buffer & appendbf(boost::format & fmt);
 		void DLL_PRIVATE flatten() const;
+		[[nodiscard]] size_t DLL_PRIVATE fragmentStart(size_t) const;
 
 		class DLL_PRIVATE FragmentBase {
 		public:
@@ -130,7 +141,6 @@ namespace AdHoc {
 			SPECIAL_MEMBERS_DEFAULT(FragmentBase);
 
 			[[nodiscard]] virtual size_t length() const = 0;
-			[[nodiscard]] virtual char operator[](size_t) const = 0;
 			[[nodiscard]] virtual const char * c_str() const = 0;
 			[[nodiscard]] virtual std::string str() const = 0;
 		};
@@ -145,7 +155,6 @@ namespace AdHoc {
 			~CStringFragment() override;
 
 			[[nodiscard]] size_t length() const override;
-			[[nodiscard]] char operator[](size_t) const override;
 			[[nodiscard]] const char * c_str() const override;
 			[[nodiscard]] std::string str() const override;
 
@@ -160,17 +169,26 @@ namespace AdHoc {
 			explicit StringFragment(std::string);
 
 			[[nodiscard]] size_t length() const override;
-			[[nodiscard]] char operator[](size_t) const override;
 			[[nodiscard]] const char * c_str() const override;
 			[[nodiscard]] std::string str() const override;
 
+			void append(const char *, size_t);
+			void reserve(size_t);
+
 		private:
-			const std::string buf;
+			std::string buf;
 		};
 
 		using FragmentPtr = std::shared_ptr<FragmentBase>;
 		using Content = std::vector<FragmentPtr>;
+		void DLL_PRIVATE push(FragmentPtr);
+		void DLL_PRIVATE reset(FragmentPtr) const;
+
+		// Fragments and, in parallel, their data and the running total of their lengths,
+		// such that reads need not go through the fragments themselves.
 		mutable Content content;
+		mutable std::vector<const char *> fragmentData;
+		mutable std::vector<size_t> fragmentEnd;
 	};
 
 }
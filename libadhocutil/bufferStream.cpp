@@ -0,0 +1,112 @@
+#include "bufferStream.h"
+#include <cerrno>
+#include <cstring>
+#include <sys.h>
+#include <sys/types.h>
+#include <utility>
+
+namespace AdHoc {
+	BufferStreamBuf::BufferStreamBuf(Buffer & b, std::size_t cs) : buffer(b), chunkSize(cs ? cs : 1)
+	{
+		newChunk();
+	}
+
+	BufferStreamBuf::~BufferStreamBuf()
+	{
+		appendChunk();
+	}
+
+	void
+	BufferStreamBuf::newChunk()
+	{
+		chunk.resize(chunkSize);
+		setp(chunk.data(), chunk.data() + chunk.size());
+	}
+
+	void
+	BufferStreamBuf::appendChunk()
+	{
+		if (const auto used = static_cast<std::size_t>(pptr() - pbase())) {
+			if (used < chunkSize / 2) {
+				// Mostly empty (e.g. flushed per line); copy out what's used, rather than keep the whole chunk
+				buffer.append(std::string(pbase(), used));
+				setp(chunk.data(), chunk.data() + chunk.size());
+			}
+			else {
+				chunk.resize(used);
+				buffer.append(std::move(chunk));
+				chunk = {};
+				newChunk();
+			}
+		}
+	}
+
+	int
+	BufferStreamBuf::sync()
+	{
+		appendChunk();
+		return 0;
+	}
+
+	BufferStreamBuf::int_type
+	BufferStreamBuf::overflow(int_type ch)
+	{
+		appendChunk();
+		if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	}
+
+	std::streamsize
+	BufferStreamBuf::xsputn(const char_type * s, std::streamsize n)
+	{
+		if (static_cast<std::size_t>(n) < chunkSize) {
+			return std::streambuf::xsputn(s, n);
+		}
+		appendChunk();
+		buffer.append(std::string(s, static_cast<std::size_t>(n)));
+		return n;
+	}
+
+	BufferStream::BufferStream(Buffer & b, std::size_t chunkSize) : buf(b, chunkSize)
+	{
+		init(&buf);
+	}
+
+	BufferStream::~BufferStream()
+	{
+		buf.pubsync();
+	}
+
+	namespace {
+		ssize_t
+		bufferFileWrite(void * cookie, const char * data, size_t size)
+		{
+			static_cast<Buffer *>(cookie)->append(std::string(data, size));
+			return static_cast<ssize_t>(size);
+		}
+	}
+
+	BufferFile::BufferFile(Buffer & b) :
+		strm(fopencookie(&b, "w",
+				{.read = nullptr, .write = &bufferFileWrite, .seek = nullptr, .close = nullptr}))
+	{
+		if (!strm) {
+			// LCOV_EXCL_START no sensible way to make fopencookie fail
+			throw SystemException("fopencookie failed", strerror(errno), errno);
+			// LCOV_EXCL_STOP
+		}
+	}
+
+	BufferFile::~BufferFile()
+	{
+		fclose(strm);
+	}
+
+	BufferFile::operator FILE *() noexcept
+	{
+		return strm;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "buffer.h"
+#include "c++11Helpers.h"
+#include "visibility.h"
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace AdHoc {
+	/**
+	 * A std::streambuf which appends to a Buffer.
+	 * Output is collected in chunks which are moved into the Buffer as fragments
+	 * when full or on sync (or copied, if mostly empty); large writes are appended directly.
+	 */
+	class DLL_PUBLIC BufferStreamBuf : public std::streambuf {
+	public:
+		/// Default size of each chunk.
+		static constexpr std::size_t DEFAULT_CHUNK_SIZE = 4096;
+
+		/**
+		 * Create a streambuf appending to the given Buffer.
+		 * @param buffer the Buffer to append to.
+		 * @param chunkSize the size of each chunk.
+		 */
+		explicit BufferStreamBuf(Buffer & buffer, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+		~BufferStreamBuf() override;
+
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(BufferStreamBuf);
+
+	protected:
+		/// Append the current chunk to the Buffer.
+		int sync() override;
+		/// Append the current chunk to the Buffer and start a new one.
+		int_type overflow(int_type ch) override;
+		/// Write a sequence of characters, directly to the Buffer if larger than a chunk.
+		std::streamsize xsputn(const char_type * s, std::streamsize n) override;
+
+	private:
+		void DLL_PRIVATE newChunk();
+		void DLL_PRIVATE appendChunk();
+
+		Buffer & buffer;
+		const std::size_t chunkSize;
+		std::string chunk;
+	};
+
+	/**
+	 * A std::ostream which appends to a Buffer.
+	 * Content is in the Buffer after flush() or destruction.
+	 */
+	class DLL_PUBLIC BufferStream : public std::ostream {
+	public:
+		/**
+		 * Create a stream appending to the given Buffer.
+		 * @param buffer the Buffer to append to.
+		 * @param chunkSize the size of each chunk.
+		 */
+		explicit BufferStream(Buffer & buffer, std::size_t chunkSize = BufferStreamBuf::DEFAULT_CHUNK_SIZE);
+		~BufferStream() override;
+
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(BufferStream);
+
+	private:
+		BufferStreamBuf buf;
+	};
+
+	/**
+	 * Wrapper around fopencookie(3) appending to a Buffer.
+	 * Content is in the Buffer after fflush(3) or destruction.
+	 */
+	class DLL_PUBLIC BufferFile {
+	public:
+		/**
+		 * Create a FILE * appending to the given Buffer.
+		 * @param buffer the Buffer to append to.
+		 */
+		explicit BufferFile(Buffer & buffer);
+		~BufferFile();
+
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(BufferFile);
+
+		/// Implicit conversion to use as FILE* for writes
+		// NOLINTNEXTLINE(hicpp-explicit-conversions)
+		operator FILE *() noexcept;
+
+	private:
+		FILE * strm;
+	};
+}
@@ -0,0 +1,105 @@
+#include "charClass.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#endif
+
+namespace AdHoc {
+	namespace {
+		constexpr size_t HALF = 16;
+
+		bool
+		member(const CharClass::Table & table, unsigned char c)
+		{
+			// Bytes are split into nibbles: the low nibble (and top bit) selects the table entry, the high
+			// nibble (less the top bit) selects the bit within it. Laid out this way for pshufb lookups.
+			return (table[((c & 0x80U) ? HALF : 0) + (c & 0x0FU)] & (1U << ((c >> 4U) & 0x07U))) != 0;
+		}
+
+#if defined(__x86_64__) || defined(__i386__)
+		__attribute__((target("avx2"))) size_t
+		spanAvx2(const CharClass::Table & table, const char * string, size_t length)
+		{
+			constexpr size_t BLOCK = sizeof(__m256i);
+			const auto low = _mm256_broadcastsi128_si256(
+					_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.data()))); // NOLINT
+			const auto high = _mm256_broadcastsi128_si256(
+					_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.data() + HALF))); // NOLINT
+			const auto bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+					8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+			const auto nibble = _mm256_set1_epi8(0x0F);
+			const auto topBit = _mm256_set1_epi8(-128);
+			size_t n = 0;
+			for (; n + BLOCK <= length; n += BLOCK) {
+				const auto input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(string + n)); // NOLINT
+				// pshufb yields zero for indexes with the top bit set, so each table only answers for its half
+				const auto entries = _mm256_or_si256(_mm256_shuffle_epi8(low, input),
+						_mm256_shuffle_epi8(high, _mm256_xor_si256(input, topBit)));
+				const auto bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+				const auto misses = static_cast<unsigned int>(_mm256_movemask_epi8(
+						_mm256_cmpeq_epi8(_mm256_and_si256(entries, bit), _mm256_setzero_si256())));
+				if (misses) {
+					return n + static_cast<size_t>(__builtin_ctz(misses));
+				}
+			}
+			return n;
+		}
+
+		const bool haveAvx2 = __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	CharClass::CharClass(const char * definition) : CharClass(std::string_view {definition}) { }
+
+	CharClass::CharClass(std::string_view definition) : table {}
+	{
+		const bool negate = definition.starts_with('^');
+		if (negate) {
+			definition.remove_prefix(1);
+		}
+		const auto add = [this](unsigned char c) {
+			table[((c & 0x80U) ? HALF : 0) + (c & 0x0FU)] |= static_cast<uint8_t>(1U << ((c >> 4U) & 0x07U));
+		};
+		for (size_t i = 0; i < definition.length(); ++i) {
+			const auto from = static_cast<unsigned char>(definition[i]);
+			if (i + 2 < definition.length() && definition[i + 1] == '-') {
+				const auto to = static_cast<unsigned char>(definition[i + 2]);
+				for (unsigned int c = from; c <= to; ++c) {
+					add(static_cast<unsigned char>(c));
+				}
+				i += 2;
+			}
+			else {
+				add(from);
+			}
+		}
+		if (negate) {
+			for (auto & entry : table) {
+				entry = static_cast<uint8_t>(~entry);
+			}
+		}
+	}
+
+	bool
+	CharClass::contains(char c) const
+	{
+		return member(table, static_cast<unsigned char>(c));
+	}
+
+	size_t
+	CharClass::span(const char * string, size_t length) const
+	{
+		size_t n = 0;
+#if defined(__x86_64__) || defined(__i386__)
+		if (haveAvx2) {
+			n = spanAvx2(table, string, length);
+		}
+#endif
+		while (n < length && contains(string[n])) {
+			n += 1;
+		}
+		return n;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "visibility.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace AdHoc {
+	/**
+	 * A set of bytes, for fast membership tests and spans, e.g. by URI parsing and the Lexer class matchers.
+	 * Defined by a string of bytes, in which a-z denotes a range and a leading ^ negates the set.
+	 * A - at the start or end is literal.
+	 */
+	class DLL_PUBLIC CharClass {
+	public:
+		/// Membership bitmap, split by nibble for vectorised lookup.
+		using Table = std::array<uint8_t, 32>;
+
+		/// Construct from a class definition.
+		CharClass(std::string_view definition); // NOLINT(hicpp-explicit-conversions)
+		/// Construct from a class definition.
+		CharClass(const char * definition); // NOLINT(hicpp-explicit-conversions)
+
+		/// Test the given byte for membership.
+		[[nodiscard]] bool contains(char c) const;
+
+		/// Get the length of the run of member bytes at the start of the given input.
+		[[nodiscard]] size_t span(const char * string, size_t length) const;
+
+	private:
+		Table table;
+	};
+}
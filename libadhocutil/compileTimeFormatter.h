@@ -1,12 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <boost/preprocessor/control/iif.hpp> // IWYU pragma: keep
 #include <boost/preprocessor/variadic/size.hpp> // IWYU pragma: keep
 #include <cstddef>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <sstream> // IWYU pragma: export
+#include <streambuf>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 // Mapped for for BOOST_PP_VARIADIC_SIZE, BOOST_PP... in tests
@@ -79,6 +83,111 @@ namespace AdHoc {
 
 	template<const auto S, const auto L> class FormatterDetail;
 
+	/**
+	 * A std::streambuf which writes into caller provided, fixed size storage.
+	 * Writes beyond the end of the storage are discarded and flagged as truncation.
+	 */
+	template<typename char_type> class SpanStreamBuf : public std::basic_streambuf<char_type> {
+	public:
+		/// Base streambuf type.
+		using base = std::basic_streambuf<char_type>;
+
+		/**
+		 * Create a streambuf writing into the given storage.
+		 * @param s the storage to write into.
+		 */
+		explicit SpanStreamBuf(std::span<char_type> s)
+		{
+			this->setp(s.data(), s.data() + s.size());
+		}
+
+		/// Get the number of characters written.
+		[[nodiscard]] std::size_t
+		length() const noexcept
+		{
+			return static_cast<std::size_t>(this->pptr() - this->pbase());
+		}
+		/// Get a view of the characters written.
+		[[nodiscard]] std::basic_string_view<char_type>
+		sv() const noexcept
+		{
+			return {this->pbase(), length()};
+		}
+		/// Get whether any writes were discarded due to lack of space.
+		[[nodiscard]] bool
+		truncated() const noexcept
+		{
+			return trunc;
+		}
+
+	protected:
+		/// Called when the storage is full; records truncation.
+		typename base::int_type
+		overflow(typename base::int_type ch) override
+		{
+			if (!base::traits_type::eq_int_type(ch, base::traits_type::eof())) {
+				trunc = true;
+			}
+			return base::traits_type::eof();
+		}
+		/// Report current write position (supports tellp()).
+		typename base::pos_type
+		seekoff(typename base::off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+		{
+			if (off == 0 && dir == std::ios_base::cur && (which & std::ios_base::out)) {
+				return typename base::pos_type(static_cast<typename base::off_type>(length()));
+			}
+			return typename base::pos_type(typename base::off_type(-1));
+		}
+
+	private:
+		bool trunc {false};
+	};
+
+	/**
+	 * An output stream backed by fixed size storage on the stack.
+	 * Allows formatting without any heap allocation.
+	 * @param N the capacity in characters.
+	 */
+	template<std::size_t N, typename char_type = char> class FixedBuffer : public std::basic_ostream<char_type> {
+	public:
+		/// Create an empty buffer.
+		FixedBuffer() : buf {{storage.data(), N}}
+		{
+			this->init(&buf);
+		}
+
+		/// Get a view of the characters written.
+		[[nodiscard]] std::basic_string_view<char_type>
+		sv() const noexcept
+		{
+			return buf.sv();
+		}
+		/// Get the number of characters written.
+		[[nodiscard]] std::size_t
+		length() const noexcept
+		{
+			return buf.length();
+		}
+		/// Get whether any writes were discarded due to lack of space.
+		[[nodiscard]] bool
+		truncated() const noexcept
+		{
+			return buf.truncated();
+		}
+		/// Get the capacity of the buffer.
+		static constexpr std::size_t
+		capacity() noexcept
+		{
+			return N;
+		}
+
+	private:
+		// NOLINTNEXTLINE(hicpp-member-init)
+		std::array<char_type, N> storage;
+		SpanStreamBuf<char_type> buf;
+	};
+
 	/// Template used to apply parameters to a stream.
 	template<const auto S, auto L, auto pos, typename stream, typename, auto...> struct StreamWriter {
 		/// Write parameters to stream.
@@ -90,6 +199,29 @@ namespace AdHoc {
 		}
 	};
 
+	/// Sum two output length bounds, either of which may be unbounded (empty).
+	constexpr std::optional<std::size_t>
+	addLengths(std::optional<std::size_t> a, std::optional<std::size_t> b)
+	{
+		if (a && b) {
+			return *a + *b;
+		}
+		return {};
+	}
+
+	/// Get the output length bound of a StreamWriter, or empty if it does not provide one.
+	template<typename Writer, typename... Pn>
+	constexpr std::optional<std::size_t>
+	writerMaxLength()
+	{
+		if constexpr (requires { Writer::template maxLength<Pn...>(); }) {
+			return Writer::template maxLength<Pn...>();
+		}
+		else {
+			return {};
+		}
+	}
+
 	/// Helper to simplify implementations of StreamWriter.
 	template<const auto S, auto L, auto pos, typename stream> struct StreamWriterBase {
 		/// Continue processing parameters.
@@ -99,6 +231,13 @@ namespace AdHoc {
 		{
 			FormatterDetail<S, L>::template Parser<stream, pos + 1, Pn...>::run(s, std::forward<Pn>(pn)...);
 		}
+		/// Output length bound of the remaining parameters.
+		template<typename... Pn>
+		static constexpr std::optional<std::size_t>
+		nextMaxLength()
+		{
+			return FormatterDetail<S, L>::template Parser<stream, pos + 1, Pn...>::maxLength();
+		}
 	};
 
 #define StreamWriterT(...) \
@@ -131,6 +270,12 @@ namespace AdHoc {
 			s << '%';
 			StreamWriter::next(s, std::forward<Pn>(pn)...);
 		}
+		template<typename... Pn>
+		static constexpr std::optional<std::size_t>
+		maxLength()
+		{
+			return addLengths(1U, StreamWriter::template nextMaxLength<Pn...>());
+		}
 	};
 
 	template<typename stream, typename char_type>
@@ -208,31 +353,104 @@ namespace AdHoc {
 			return write(s, std::forward<Pn>(pn)...);
 		}
 
+		/**
+		 * Write the result of formatting to the given fixed size buffer.
+		 * @param buf the buffer to write to.
+		 * @param pn the format arguments.
+		 * @return the number of characters written, or empty if the output was truncated
+		 * (in which case buf is filled with the start of the output).
+		 */
+		template<typename... Pn>
+		static inline std::optional<std::size_t>
+		writeTo(std::span<char_type> buf, Pn &&... pn)
+		{
+			SpanStreamBuf<char_type> sb {buf};
+			std::basic_ostream<char_type> s {&sb};
+			write(s, std::forward<Pn>(pn)...);
+			if (sb.truncated()) {
+				return {};
+			}
+			return sb.length();
+		}
+
+		/**
+		 * Get an upper bound on the length of the output for the given parameter types.
+		 * Useful for sizing a FixedBuffer.
+		 * @return the maximum length, or empty if the output is unbounded (e.g. contains %? or %s).
+		 */
+		template<typename... Pn>
+		static constexpr std::optional<std::size_t>
+		maxLength()
+		{
+			return Parser<std::basic_ostream<char_type>, 0U, Pn...>::maxLength();
+		}
+
 	private:
+		/// Number of '%' characters in the format string.
+		static constexpr std::size_t placeholderCount = []() {
+			std::size_t n = 0;
+			for (strlen_t i = 0; i < L; ++i) {
+				if (S[i] == '%') {
+					++n;
+				}
+			}
+			return n;
+		}();
+		/// The format string tokenised into segments; the position of each '%' followed by L.
+		static constexpr auto segments = []() {
+			std::array<strlen_t, placeholderCount + 1> seg {};
+			std::size_t n = 0;
+			for (strlen_t i = 0; i < L; ++i) {
+				if (S[i] == '%') {
+					seg[n++] = i;
+				}
+			}
+			seg[n] = L;
+			return seg;
+		}();
+		/// Position of the first placeholder at or after pos (or L if none).
+		static constexpr strlen_t
+		nextPlaceholder(strlen_t pos)
+		{
+			return *std::lower_bound(segments.begin(), segments.end(), pos);
+		}
+
+		template<typename stream, strlen_t ph, std::size_t... I>
+		static auto writerFor(std::index_sequence<I...>) -> StreamWriter<S, L, ph, stream, void, S[ph + I]...>;
+		/// The StreamWriter for the placeholder at ph, matched against (up to 32 of) the following characters.
+		template<typename stream, strlen_t ph>
+		using Writer = decltype(writerFor<stream, ph>(
+				std::make_index_sequence<std::min<std::size_t>(static_cast<std::size_t>(L - ph), 32U)>()));
+
 		template<typename stream, auto pos, typename... Pn> struct Parser {
 			static inline stream &
 			run(stream & s, Pn &&... pn)
 			{
-				if (pos != L) {
-					constexpr auto ph = strchrnul<S, '%', pos, L>();
+				if constexpr (pos != L) {
+					constexpr auto ph = nextPlaceholder(pos);
 					if constexpr (ph != pos) {
 						appendStream(s, &S[pos], ph - pos);
 					}
 					if constexpr (ph != L) {
-						packAndWrite<ph>(s, std::forward<Pn>(pn)...);
+						Writer<stream, ph>::write(s, pn...);
 					}
 				}
 				return s;
 			}
-			template<strlen_t ph, strlen_t off = 0U, auto... Pck>
-			static inline void
-			packAndWrite(stream & s, Pn &&... pn)
+			static constexpr std::optional<std::size_t>
+			maxLength()
 			{
-				if constexpr (ph + off == L || sizeof...(Pck) == 32) {
-					StreamWriter<S, L, ph, stream, void, Pck...>::write(s, pn...);
+				if constexpr (pos == L) {
+					return 0U;
 				}
-				else if constexpr (ph + off < L) {
-					packAndWrite<ph, off + 1, Pck..., S[ph + off]>(s, std::forward<Pn>(pn)...);
+				else {
+					constexpr auto ph = nextPlaceholder(pos);
+					if constexpr (ph == L) {
+						return ph - pos;
+					}
+					else {
+						return addLengths(ph - pos, writerMaxLength<Writer<stream, ph>, Pn...>());
+					}
 				}
 			}
 		};
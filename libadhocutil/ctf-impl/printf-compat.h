@@ -1,80 +1,619 @@
 #pragma once
 
 #include "../compileTimeFormatter.h"
+#include <algorithm>
+#include <array>
 #include <boost/assert.hpp>
 #include <boost/preprocessor/arithmetic/add.hpp>
 #include <boost/preprocessor/cat.hpp>
 #include <boost/preprocessor/comma_if.hpp>
 #include <boost/preprocessor/if.hpp>
+#include <boost/preprocessor/punctuation/remove_parens.hpp>
 #include <boost/preprocessor/repetition/repeat.hpp>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <iomanip>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <type_traits>
 
 namespace AdHoc {
-#define BASICCONV(PARAMTYPE, OP, ...) \
+	namespace PrintfCompat {
+		/// Flags, width and precision of a conversion specification, resolved at compile time.
+		struct Spec {
+			/// '-' flag
+			bool left {false};
+			/// '+' flag
+			bool plus {false};
+			/// ' ' flag
+			bool space {false};
+			/// '#' flag
+			bool alt {false};
+			/// '0' flag
+			bool zero {false};
+			/// Minimum field width
+			std::size_t width {0};
+			/// Precision was specified
+			bool hasPrecision {false};
+			/// Precision (if hasPrecision)
+			std::size_t precision {0};
+		};
+
+		/// The precision of spec, if it has one.
+		template<Spec spec>
+		constexpr std::optional<std::size_t>
+		precisionOf()
+		{
+			if constexpr (spec.hasPrecision) {
+				return spec.precision;
+			}
+			return {};
+		}
+
+		/// A precision passed as an argument ('.*') to the conversion's kernel.
+		struct RuntimePrecision {
+			/// The precision; none if the argument was negative, as if omitted
+			std::optional<std::size_t> precision;
+		};
+
+		/// The character type of a format string.
+		template<const auto S> using FormatChar = typename std::decay<decltype(S[0])>::type;
+
+		/// \\private
+		template<typename char_type>
+		constexpr bool
+		oneOf(const char_type ch, const std::string_view set)
+		{
+			return std::any_of(set.begin(), set.end(), [ch](auto c) {
+				return ch == c;
+			});
+		}
+
+		/**
+		 * Parse the specification of a conversion.
+		 * @param S the format string.
+		 * @param pos the position of the conversion's '%', or its last flag/width/precision character.
+		 */
+		template<const auto S, auto pos>
+		constexpr Spec
+		parseSpec()
+		{
+			auto i = pos;
+			while (S[i] != '%') {
+				--i;
+			}
+			Spec spec;
+			for (++i; i <= pos; ++i) {
+				const auto ch = S[i];
+				if (ch == '-') {
+					spec.left = true;
+				}
+				else if (ch == '+') {
+					spec.plus = true;
+				}
+				else if (ch == ' ') {
+					spec.space = true;
+				}
+				else if (ch == '#') {
+					spec.alt = true;
+				}
+				else if (ch == '0') {
+					spec.zero = true;
+				}
+				else {
+					break;
+				}
+			}
+			for (; i <= pos && isdigit(S[i]); ++i) {
+				spec.width = (spec.width * 10) + static_cast<std::size_t>(S[i] - '0');
+			}
+			if (i <= pos && S[i] == '.') {
+				spec.hasPrecision = true;
+				for (++i; i <= pos && isdigit(S[i]); ++i) {
+					spec.precision = (spec.precision * 10) + static_cast<std::size_t>(S[i] - '0');
+				}
+			}
+			return spec;
+		}
+
+		/**
+		 * Determine whether the conversion following S[pos] is written by one of the kernels below,
+		 * in which case flags, width and precision are taken from the format string, not stream state.
+		 */
+		template<const auto S, auto pos, auto L>
+		constexpr bool
+		isKernel()
+		{
+			auto i = pos + 1;
+			while (i < L && oneOf(S[i], "-+ #0123456789")) {
+				++i;
+			}
+			bool runtimePrecision = false;
+			if (i < L && S[i] == '.') {
+				if (i + 1 < L && S[i + 1] == '*') {
+					runtimePrecision = true;
+					i += 2;
+				}
+				else {
+					for (++i; i < L && isdigit(S[i]);) {
+						++i;
+					}
+				}
+			}
+			bool wide = false;
+			while (i < L && oneOf(S[i], "hlLjz")) {
+				wide = wide || S[i] == 'l';
+				++i;
+			}
+			if (i == L) {
+				return false;
+			}
+			if (oneOf(S[i], "cs")) {
+				return !wide;
+			}
+			// p and m are not given a runtime precision
+			return oneOf(S[i], runtimePrecision ? "diouxXaAeEfFgG" : "diouxXaAeEfFgGpm");
+		}
+
+		/// Restore default formatting state, for conversions that rely on stream manipulators.
+		template<typename stream>
+		void
+		resetFormat(stream & s)
+		{
+			s.flags(std::ios_base::skipws | std::ios_base::dec);
+			s.fill(s.widen(' '));
+			s.precision(6);
+			s.width(0);
+		}
+
+		/// Write ASCII text to the stream, widening if required.
+		template<typename char_type, typename stream>
+		void
+		put(stream & s, const std::string_view str)
+		{
+			if constexpr (std::is_same_v<char_type, char>) {
+				if (!str.empty()) {
+					appendStream(s, str.data(), static_cast<std::streamsize>(str.length()));
+				}
+			}
+			else {
+				for (const char ch : str) {
+					const char_type wch = ch;
+					appendStream(s, &wch, 1);
+				}
+			}
+		}
+
+		/// Write n copies of ch to the stream.
+		template<typename char_type, typename stream>
+		void
+		pad(stream & s, const char_type ch, std::size_t n)
+		{
+			if (!n) {
+				return;
+			}
+			std::array<char_type, 32> fill {};
+			fill.fill(ch);
+			while (n) {
+				const auto chunk = std::min(n, fill.size());
+				appendStream(s, fill.data(), static_cast<std::streamsize>(chunk));
+				n -= chunk;
+			}
+		}
+
+		/**
+		 * Write a converted value: prefix (sign/base), leading zeros and body, justified within the field width.
+		 * @param zeroPad whether the '0' flag applies to this value.
+		 */
+		template<Spec spec, typename char_type, typename stream>
+		void
+		emit(stream & s, const std::string_view prefix, const std::size_t zeros, const std::string_view body,
+				const bool zeroPad)
+		{
+			const auto len = prefix.length() + zeros + body.length();
+			const auto padding = spec.width > len ? spec.width - len : 0;
+			if constexpr (spec.left) {
+				put<char_type>(s, prefix);
+				pad<char_type>(s, '0', zeros);
+				put<char_type>(s, body);
+				pad<char_type>(s, ' ', padding);
+			}
+			else {
+				if (spec.zero && zeroPad) {
+					put<char_type>(s, prefix);
+					pad<char_type>(s, '0', zeros + padding);
+				}
+				else {
+					pad<char_type>(s, ' ', padding);
+					put<char_type>(s, prefix);
+					pad<char_type>(s, '0', zeros);
+				}
+				put<char_type>(s, body);
+			}
+		}
+
+		/// Apply the field width to a content length bound.
+		template<Spec spec>
+		constexpr std::size_t
+		fieldLength(const std::size_t len)
+		{
+			return std::max(spec.width, len);
+		}
+
+		/// \\private
+		inline void
+		toUpper(char * first, char * const last)
+		{
+			std::transform(first, last, first, [](char ch) {
+				return (ch >= 'a' && ch <= 'z') ? static_cast<char>(ch - 'a' + 'A') : ch;
+			});
+		}
+
+		/// Integer conversions (d, i, o, u, x, X).
+		template<typename T, int base, bool upper> struct Integer {
+			/// Parameter type
+			using param_type = T;
+			/// Unsigned type wide enough to avoid integer promotion
+			using work_type = std::common_type_t<std::make_unsigned_t<T>, unsigned int>;
+			/// Maximum number of digits
+			static constexpr std::size_t digits = []() -> std::size_t {
+				constexpr auto bits = std::numeric_limits<std::make_unsigned_t<T>>::digits;
+				if constexpr (base == 8) {
+					return (bits / 3) + 1;
+				}
+				else if constexpr (base == 16) {
+					return (bits + 3) / 4;
+				}
+				else {
+					return std::numeric_limits<std::make_unsigned_t<T>>::digits10 + 1;
+				}
+			}();
+
+			/// Write p to s, with the given precision (by default, that of spec).
+			template<Spec spec, typename char_type, typename stream>
+			static void
+			write(stream & s, const T p, const std::optional<std::size_t> precision = precisionOf<spec>())
+			{
+				work_type u {};
+				std::string_view prefix;
+				if constexpr (std::is_signed_v<T>) {
+					u = static_cast<work_type>(p);
+					if (p < 0) {
+						u = work_type {} - u;
+						prefix = "-";
+					}
+					else if constexpr (spec.plus) {
+						prefix = "+";
+					}
+					else if constexpr (spec.space) {
+						prefix = " ";
+					}
+				}
+				else {
+					u = p;
+					if constexpr (spec.alt && base == 16) {
+						if (u) {
+							prefix = upper ? "0X" : "0x";
+						}
+					}
+				}
+				std::array<char, std::numeric_limits<work_type>::digits / 3 + 1> buf {};
+				std::string_view body;
+				if (!(precision == 0U && u == 0)) {
+					const auto res = std::to_chars(buf.data(), buf.data() + buf.size(), u, base);
+					if constexpr (upper) {
+						toUpper(buf.data(), res.ptr);
+					}
+					body = {buf.data(), res.ptr};
+				}
+				std::size_t zeros = 0;
+				if (precision > body.length()) {
+					zeros = *precision - body.length();
+				}
+				if constexpr (spec.alt && base == 8) {
+					if (!zeros && (body.empty() || body.front() != '0')) {
+						zeros = 1;
+					}
+				}
+				emit<spec, char_type>(s, prefix, zeros, body, !precision);
+			}
+
+			/// Maximum output length.
+			template<Spec spec>
+			static constexpr std::optional<std::size_t>
+			maxLength()
+			{
+				return fieldLength<spec>(std::max(digits, spec.precision) + 2);
+			}
+		};
+
+		/// Floating point conversions (a, A, e, E, f, F, g, G).
+		template<typename T, std::chars_format fmt, bool upper> struct Float {
+			/// Parameter type
+			using param_type = T;
+
+			/// Maximum length of the converted value, excluding sign and prefix.
+			static constexpr std::size_t
+			bodyLength(const std::optional<std::size_t> precision)
+			{
+				using limits = std::numeric_limits<T>;
+				if constexpr (fmt == std::chars_format::hex) {
+					// d.ddd...p+ddddd
+					return 2 + std::max(precision.value_or(6), static_cast<std::size_t>((limits::digits + 3) / 4))
+							+ 8;
+				}
+				else {
+					// Fixed notation is the longest; d...d.ddd (or d.ddde+dddd / nan / inf)
+					return static_cast<std::size_t>(limits::max_exponent10) + 2 + precision.value_or(6) + 8;
+				}
+			}
+
+			/// Write p to s, with the given precision (by default, that of spec).
+			template<Spec spec, typename char_type, typename stream>
+			static void
+			write(stream & s, const T p, const std::optional<std::size_t> precision = precisionOf<spec>())
+			{
+				std::array<char, bodyLength(precisionOf<spec>()) + 1> local {};
+				// Only a runtime precision can need more
+				std::string heap;
+				char * str = local.data();
+				std::size_t size = local.size();
+				if (const auto needed = bodyLength(precision) + 1; needed > size) {
+					heap.resize(needed);
+					str = heap.data();
+					size = needed;
+				}
+				const auto res = (fmt == std::chars_format::hex && !precision)
+						? std::to_chars(str, str + size, p, fmt)
+						: std::to_chars(str, str + size, p, fmt, static_cast<int>(precision.value_or(6)));
+				if constexpr (upper) {
+					toUpper(str, res.ptr);
+				}
+				std::string_view body {str, res.ptr};
+				if constexpr (spec.alt) {
+					if (std::isfinite(p)) {
+						body = alternate(str, body.length(), precision);
+					}
+				}
+				std::array<char, 3> prefixBuf {};
+				std::size_t prefixLen = 0;
+				if (body.front() == '-') {
+					prefixBuf[prefixLen++] = '-';
+					body.remove_prefix(1);
+				}
+				else if constexpr (spec.plus) {
+					prefixBuf[prefixLen++] = '+';
+				}
+				else if constexpr (spec.space) {
+					prefixBuf[prefixLen++] = ' ';
+				}
+				if constexpr (fmt == std::chars_format::hex) {
+					if (std::isfinite(p)) {
+						prefixBuf[prefixLen++] = '0';
+						prefixBuf[prefixLen++] = upper ? 'X' : 'x';
+					}
+				}
+				emit<spec, char_type>(s, {prefixBuf.data(), prefixLen}, 0, body, std::isfinite(p));
+			}
+
+			/// Apply the # flag to the finite value of the given length in str: always include a decimal point,
+			/// and for g, keep trailing zeros. str must have room for them.
+			static std::string_view
+			alternate(char * const str, const std::size_t length, const std::optional<std::size_t> precision)
+			{
+				const std::string_view body {str, length};
+				const auto exponent = std::min(body.find_first_of(fmt == std::chars_format::hex ? "pP" : "eE"), length);
+				const auto mantissa = body.substr(0, exponent);
+				const std::size_t point = mantissa.find('.') == std::string_view::npos ? 1 : 0;
+				std::size_t zeros = 0;
+				if constexpr (fmt == std::chars_format::general) {
+					const std::size_t wanted = precision ? std::max<std::size_t>(*precision, 1) : 6;
+					// Significant digits so far; zero has just the one
+					const auto first = mantissa.find_first_of("123456789");
+					const auto significant = first == std::string_view::npos
+							? 1
+							: mantissa.length() - first - (mantissa.find('.', first) == std::string_view::npos ? 0 : 1);
+					zeros = wanted > significant ? wanted - significant : 0;
+				}
+				std::memmove(str + exponent + point + zeros, str + exponent, length - exponent);
+				if (point) {
+					str[exponent] = '.';
+				}
+				std::fill_n(str + exponent + point, zeros, '0');
+				return {str, length + point + zeros};
+			}
+
+			/// Maximum output length.
+			template<Spec spec>
+			static constexpr std::optional<std::size_t>
+			maxLength()
+			{
+				return fieldLength<spec>(bodyLength(precisionOf<spec>()) + 3);
+			}
+		};
+
+		/// String conversion (s).
+		struct String {
+			/// Parameter type
+			using param_type = std::string_view;
+
+			/// Write p to s, truncated to the given precision (by default, that of spec).
+			template<Spec spec, typename char_type, typename stream>
+			static void
+			write(stream & s, std::string_view p, const std::optional<std::size_t> precision = precisionOf<spec>())
+			{
+				if (precision) {
+					p = p.substr(0, *precision);
+				}
+				emit<spec, char_type>(s, {}, 0, p, false);
+			}
+
+			/// Maximum output length.
+			template<Spec spec>
+			static constexpr std::optional<std::size_t>
+			maxLength()
+			{
+				if constexpr (spec.hasPrecision) {
+					return fieldLength<spec>(spec.precision);
+				}
+				return {};
+			}
+		};
+
+		/// Character conversion (c).
+		struct Char {
+			/// Parameter type
+			using param_type = char;
+
+			/// Write p to s; precision has no effect.
+			template<Spec spec, typename char_type, typename stream>
+			static void
+			write(stream & s, const char p, const std::optional<std::size_t> = {})
+			{
+				emit<spec, char_type>(s, {}, 0, {&p, 1}, false);
+			}
+
+			/// Maximum output length.
+			template<Spec spec>
+			static constexpr std::optional<std::size_t>
+			maxLength()
+			{
+				return fieldLength<spec>(1);
+			}
+		};
+
+		/// Pointer conversion (p).
+		struct Pointer {
+			/// Flags used for the address
+			template<Spec spec>
+			static constexpr Spec addressSpec = [] {
+				auto as = spec;
+				as.alt = true;
+				return as;
+			}();
+
+			/// Write p to s.
+			template<Spec spec, typename char_type, typename stream>
+			static void
+			write(stream & s, const void * const p)
+			{
+				if (p) {
+					Integer<std::uintptr_t, 16, false>::write<addressSpec<spec>, char_type>(
+							s, reinterpret_cast<std::uintptr_t>(p));
+				}
+				else {
+					emit<spec, char_type>(s, {}, 0, "(nil)", false);
+				}
+			}
+
+			/// Maximum output length.
+			template<Spec spec>
+			static constexpr std::optional<std::size_t>
+			maxLength()
+			{
+				return Integer<std::uintptr_t, 16, false>::maxLength<addressSpec<spec>>();
+			}
+		};
+	}
+
+#define KERNELCONV(KERNEL, ...) \
 	StreamWriterT(__VA_ARGS__) { \
+		using Kernel = BOOST_PP_REMOVE_PARENS(KERNEL); \
+		static constexpr auto spec = PrintfCompat::parseSpec<S, pos>(); \
 		template<typename... Pn> \
 		static inline void \
-		write(stream & s, const PARAMTYPE & p, Pn &&... pn) \
+		write(stream & s, const typename Kernel::param_type & p, Pn &&... pn) \
 		{ \
-			OP; \
-			s.copyfmt(std::ios(nullptr)); \
+			Kernel::template write<spec, PrintfCompat::FormatChar<S>>(s, p); \
 			StreamWriter::next(s, std::forward<Pn>(pn)...); \
 		} \
+		template<typename... Pn> \
+		static inline void \
+		write(stream & s, const PrintfCompat::RuntimePrecision precision, const typename Kernel::param_type & p, \
+				Pn &&... pn) \
+		{ \
+			Kernel::template write<spec, PrintfCompat::FormatChar<S>>(s, p, precision.precision); \
+			StreamWriter::next(s, std::forward<Pn>(pn)...); \
+		} \
+		template<typename, typename... Pn> \
+		static constexpr std::optional<std::size_t> \
+		maxLength() \
+		{ \
+			return addLengths(Kernel::template maxLength<spec>(), StreamWriter::template nextMaxLength<Pn...>()); \
+		} \
 	}
 
 	// Integers (d, i, o, u, x, X)
-#define INTCONV(BASE, OP, CONV) \
-	BASICCONV(BASE, OP, CONV); \
-	BASICCONV(short BASE, OP, 'h', CONV); \
-	BASICCONV(long BASE, OP, 'l', CONV); \
-	BASICCONV(long long BASE, OP, 'l', 'l', CONV)
-	INTCONV(int, s << std::dec << p, 'i');
-	INTCONV(int, s << std::dec << p, 'd');
-	INTCONV(unsigned int, s << std::oct << p, 'o');
-	INTCONV(unsigned int, s << std::dec << p, 'u');
-	INTCONV(unsigned int, s << std::nouppercase << std::hex << p, 'x');
-	INTCONV(unsigned int, s << std::uppercase << std::hex << p, 'X');
+#define INTCONV(BASE, RADIX, UPPER, CONV) \
+	KERNELCONV((PrintfCompat::Integer<BASE, RADIX, UPPER>), CONV); \
+	KERNELCONV((PrintfCompat::Integer<short BASE, RADIX, UPPER>), 'h', CONV); \
+	KERNELCONV((PrintfCompat::Integer<long BASE, RADIX, UPPER>), 'l', CONV); \
+	KERNELCONV((PrintfCompat::Integer<long long BASE, RADIX, UPPER>), 'l', 'l', CONV)
+	INTCONV(int, 10, false, 'i');
+	INTCONV(int, 10, false, 'd');
+	INTCONV(unsigned int, 8, false, 'o');
+	INTCONV(unsigned int, 10, false, 'u');
+	INTCONV(unsigned int, 16, false, 'x');
+	INTCONV(unsigned int, 16, true, 'X');
 #undef INTCONV
 
-	BASICCONV(intmax_t, s << std::dec << p, 'j', 'd');
-	BASICCONV(uintmax_t, s << std::dec << p, 'j', 'u');
-	BASICCONV(ssize_t, s << std::dec << p, 'z', 'd');
-	BASICCONV(size_t, s << std::dec << p, 'z', 'u');
-	BASICCONV(short int, s << std::dec << p, 'h', 'h', 'i'); // char
-	BASICCONV(short int, s << std::dec << p, 'h', 'h', 'd'); // char
-	BASICCONV(unsigned char, s << std::dec << p, 'h', 'h', 'u');
-	BASICCONV(unsigned char, s << std::oct << p, 'h', 'h', 'o');
-	BASICCONV(unsigned char, s << std::nouppercase << std::hex << p, 'h', 'h', 'x');
-	BASICCONV(unsigned char, s << std::uppercase << std::hex << p, 'h', 'h', 'X');
+	KERNELCONV((PrintfCompat::Integer<intmax_t, 10, false>), 'j', 'd');
+	KERNELCONV((PrintfCompat::Integer<uintmax_t, 10, false>), 'j', 'u');
+	KERNELCONV((PrintfCompat::Integer<ssize_t, 10, false>), 'z', 'd');
+	KERNELCONV((PrintfCompat::Integer<size_t, 10, false>), 'z', 'u');
+	KERNELCONV((PrintfCompat::Integer<short int, 10, false>), 'h', 'h', 'i'); // char
+	KERNELCONV((PrintfCompat::Integer<short int, 10, false>), 'h', 'h', 'd'); // char
+	KERNELCONV((PrintfCompat::Integer<unsigned char, 10, false>), 'h', 'h', 'u');
+	KERNELCONV((PrintfCompat::Integer<unsigned char, 8, false>), 'h', 'h', 'o');
+	KERNELCONV((PrintfCompat::Integer<unsigned char, 16, false>), 'h', 'h', 'x');
+	KERNELCONV((PrintfCompat::Integer<unsigned char, 16, true>), 'h', 'h', 'X');
 
 	// Floating point (a, A, e, E, f, F, g, G)
-#define FPCONV(BASE, OP, CONV) \
-	BASICCONV(BASE, OP, CONV); \
-	BASICCONV(long BASE, OP, 'L', CONV)
-	FPCONV(double, s << std::nouppercase << std::hexfloat << p, 'a');
-	FPCONV(double, s << std::uppercase << std::hexfloat << p, 'A');
-	FPCONV(double, s << std::nouppercase << std::scientific << p, 'e');
-	FPCONV(double, s << std::uppercase << std::scientific << p, 'E');
-	FPCONV(double, s << std::nouppercase << std::fixed << p, 'f');
-	FPCONV(double, s << std::uppercase << std::fixed << p, 'F');
-	FPCONV(double, s << std::nouppercase << std::defaultfloat << p, 'g');
-	FPCONV(double, s << std::uppercase << std::defaultfloat << p, 'G');
+#define FPCONV(FMT, UPPER, CONV) \
+	KERNELCONV((PrintfCompat::Float<double, FMT, UPPER>), CONV); \
+	KERNELCONV((PrintfCompat::Float<long double, FMT, UPPER>), 'L', CONV)
+	FPCONV(std::chars_format::hex, false, 'a');
+	FPCONV(std::chars_format::hex, true, 'A');
+	FPCONV(std::chars_format::scientific, false, 'e');
+	FPCONV(std::chars_format::scientific, true, 'E');
+	FPCONV(std::chars_format::fixed, false, 'f');
+	FPCONV(std::chars_format::fixed, true, 'F');
+	FPCONV(std::chars_format::general, false, 'g');
+	FPCONV(std::chars_format::general, true, 'G');
 #undef FPCONV
 
-	BASICCONV(std::string_view, s << p, 's');
-	BASICCONV(std::wstring_view, s << p, 'l', 's');
-	BASICCONV(char, s << p, 'c');
-	BASICCONV(wchar_t, s << p, 'l', 'c');
-#undef BASICCONV
+	KERNELCONV(PrintfCompat::String, 's');
+	KERNELCONV(PrintfCompat::Char, 'c');
+#undef KERNELCONV
+
+	// Wide characters/strings rely on the stream's own conversion
+#define STREAMCONV(PARAMTYPE, ...) \
+	StreamWriterT(__VA_ARGS__) { \
+		template<typename... Pn> \
+		static inline void \
+		write(stream & s, const PARAMTYPE & p, Pn &&... pn) \
+		{ \
+			s << p; \
+			PrintfCompat::resetFormat(s); \
+			StreamWriter::next(s, std::forward<Pn>(pn)...); \
+		} \
+	}
+	STREAMCONV(std::wstring_view, 'l', 's');
+	STREAMCONV(wchar_t, 'l', 'c');
+#undef STREAMCONV
+
 	StreamWriterT('p') {
+		static constexpr auto spec = PrintfCompat::parseSpec<S, pos>();
 		template<typename Obj, typename... Pn>
 		static inline void
 		write(stream & s, Obj * const ptr, Pn &&... pn)
 		{
-			s << std::showbase << std::hex << reinterpret_cast<long unsigned int>(ptr);
-			s.copyfmt(std::ios(nullptr));
+			PrintfCompat::Pointer::write<spec, PrintfCompat::FormatChar<S>>(s, ptr);
 			StreamWriter::next(s, std::forward<Pn>(pn)...);
 		}
 		template<typename Ptr, typename... Pn>
@@ -83,15 +622,22 @@ namespace AdHoc {
 		{
 			write(s, ptr.get(), std::forward<Pn>(pn)...);
 		}
+		template<typename, typename... Pn>
+		static constexpr std::optional<std::size_t>
+		maxLength()
+		{
+			return addLengths(
+					PrintfCompat::Pointer::maxLength<spec>(), StreamWriter::template nextMaxLength<Pn...>());
+		}
 	};
 
 	StreamWriterT('m') {
+		static constexpr auto spec = PrintfCompat::parseSpec<S, pos>();
 		template<typename... Pn>
 		static inline void
 		write(stream & s, Pn &&... pn)
 		{
-			s << strerror(errno);
-			s.copyfmt(std::ios(nullptr));
+			PrintfCompat::String::write<spec, PrintfCompat::FormatChar<S>>(s, strerror(errno));
 			StreamWriter::next(s, std::forward<Pn>(pn)...);
 		}
 	};
@@ -102,9 +648,14 @@ namespace AdHoc {
 		{
 			BOOST_ASSERT_MSG(n, "%n conversion requires non-null parameter");
 			*n = streamLength(s);
-			s.copyfmt(std::ios(nullptr));
 			StreamWriter::next(s, std::forward<Pn>(pn)...);
 		}
+		template<typename, typename... Pn>
+		static constexpr std::optional<std::size_t>
+		maxLength()
+		{
+			return StreamWriter::template nextMaxLength<Pn...>();
+		}
 	};
 
 	////
@@ -135,14 +686,22 @@ namespace AdHoc {
 	struct StreamWriter<S, L, pos, stream, \
 			typename std::enable_if<ispositivedigit(n0) BOOST_PP_REPEAT(d, ISDIGIT, n) && !isdigit(nn)>::type, '%', \
 			BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n), nn, sn...> { \
+		using Next = StreamWriter<S, L, pos + BOOST_PP_ADD(d, 1), stream, void, '%', nn, sn...>; \
 		template<typename... Pn> \
 		static inline void \
 		write(stream & s, Pn &&... pn) \
 		{ \
-			constexpr auto p = decdigits<BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n)>(); \
-			s << std::setw(p); \
-			StreamWriter<S, L, pos + BOOST_PP_ADD(d, 1), stream, void, '%', nn, sn...>::write( \
-					s, std::forward<Pn>(pn)...); \
+			if constexpr (!PrintfCompat::isKernel<S, pos, L>()) { \
+				constexpr auto p = decdigits<BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n)>(); \
+				s << std::setw(p); \
+			} \
+			Next::write(s, std::forward<Pn>(pn)...); \
+		} \
+		template<typename... Pn> \
+		static constexpr std::optional<std::size_t> \
+		maxLength() \
+		{ \
+			return writerMaxLength<Next, Pn...>(); \
 		} \
 	};
 	BOOST_PP_REPEAT(6, FMTWIDTH, void)
@@ -152,14 +711,22 @@ namespace AdHoc {
 	struct StreamWriter<S, L, pos, stream, \
 			typename std::enable_if<isdigit(n0) BOOST_PP_REPEAT(d, ISDIGIT, n) && !isdigit(nn)>::type, '%', '.', \
 			BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n), nn, sn...> { \
+		using Next = StreamWriter<S, L, pos + BOOST_PP_ADD(d, 2), stream, void, '%', nn, sn...>; \
 		template<typename... Pn> \
 		static inline void \
 		write(stream & s, Pn &&... pn) \
 		{ \
-			constexpr auto p = decdigits<BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n)>(); \
-			s << std::setprecision(p); \
-			StreamWriter<S, L, pos + BOOST_PP_ADD(d, 2), stream, void, '%', nn, sn...>::write( \
-					s, std::forward<Pn>(pn)...); \
+			if constexpr (!PrintfCompat::isKernel<S, pos, L>()) { \
+				constexpr auto p = decdigits<BOOST_PP_REPEAT(BOOST_PP_ADD(d, 1), NS, n)>(); \
+				s << std::setprecision(p); \
+			} \
+			Next::write(s, std::forward<Pn>(pn)...); \
+		} \
+		template<typename... Pn> \
+		static constexpr std::optional<std::size_t> \
+		maxLength() \
+		{ \
+			return writerMaxLength<Next, Pn...>(); \
 		} \
 	};
 	BOOST_PP_REPEAT(6, FMTPRECISION, void)
@@ -169,40 +736,55 @@ namespace AdHoc {
 #undef FMTWIDTH
 
 	StreamWriterT('.', '*') {
+		using Next = StreamWriter<S, L, pos + 2, stream, void, '%', sn...>;
 		template<typename... Pn>
 		static inline void
 		write(stream & s, int l, Pn &&... pn)
 		{
-			s << std::setw(l);
-			StreamWriter<S, L, pos + 2, stream, void, '%', sn...>::write(s, std::forward<Pn>(pn)...);
+			// A negative precision is taken as if omitted
+			precise(s, l < 0 ? std::nullopt : std::make_optional(static_cast<std::size_t>(l)),
+					std::forward<Pn>(pn)...);
 		}
-	};
-	StreamWriterT('.', '*', 's') {
 		template<typename... Pn>
 		static inline void
-		write(stream & s, int l, const std::string_view p, Pn &&... pn)
+		write(stream & s, size_t l, Pn &&... pn)
 		{
-			return write(s, static_cast<size_t>(l), p, std::forward<Pn>(pn)...);
+			precise(s, l, std::forward<Pn>(pn)...);
 		}
 		template<typename... Pn>
 		static inline void
-		write(stream & s, size_t l, const std::string_view p, Pn &&... pn)
+		precise(stream & s, const std::optional<std::size_t> l, Pn &&... pn)
 		{
-			s << p.substr(0, l);
-			s.copyfmt(std::ios(nullptr));
-			StreamWriter::next(s, std::forward<Pn>(pn)...);
+			if constexpr (PrintfCompat::isKernel<S, pos, L>()) {
+				Next::write(s, PrintfCompat::RuntimePrecision {l}, std::forward<Pn>(pn)...);
+			}
+			else {
+				if (l) {
+					s << std::setprecision(static_cast<int>(*l));
+				}
+				Next::write(s, std::forward<Pn>(pn)...);
+			}
 		}
 	};
 
 		// Flags
 #define FLAGCONV(OP, ...) \
 	StreamWriterT(__VA_ARGS__) { \
+		using Next = StreamWriter<S, L, pos + 1, stream, void, '%', sn...>; \
 		template<typename... Pn> \
 		static inline void \
 		write(stream & s, Pn &&... pn) \
 		{ \
-			OP; \
-			StreamWriter<S, L, pos + 1, stream, void, '%', sn...>::write(s, std::forward<Pn>(pn)...); \
+			if constexpr (!PrintfCompat::isKernel<S, pos, L>()) { \
+				OP; \
+			} \
+			Next::write(s, std::forward<Pn>(pn)...); \
+		} \
+		template<typename... Pn> \
+		static constexpr std::optional<std::size_t> \
+		maxLength() \
+		{ \
+			return writerMaxLength<Next, Pn...>(); \
 		} \
 	}
 	FLAGCONV(s << std::showbase, '#');
@@ -0,0 +1,267 @@
+#include "curlClient.h"
+#include "curlEvents.h"
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <handle.h>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <sys.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+namespace AdHoc::Net {
+	/// A transfer and its response, as it's received.
+	class CurlClient::Transfer {
+	public:
+		Transfer(CurlHandlePtr h, Completion c) : handle {std::move(h)}, completion {std::move(c)} { }
+
+		[[nodiscard]] CURL *
+		easy() const
+		{
+			return *handle;
+		}
+
+		void
+		start(CURLM * curlm)
+		{
+			CURL * const easy = *handle;
+			if (handle->curl_headers) {
+				curl_easy_setopt(easy, CURLOPT_HTTPHEADER, handle->curl_headers);
+			}
+			curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &Transfer::recv);
+			curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+			curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &Transfer::header);
+			curl_easy_setopt(easy, CURLOPT_HEADERDATA, this);
+			curl_multi_add_handle(curlm, easy);
+		}
+
+		void
+		finished(CURLcode res, CurlTimings * timings = nullptr)
+		{
+			// Restore libcurl's defaults, rather than leave the handle referring to this
+			CURL * const easy = *handle;
+			curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, nullptr);
+			curl_easy_setopt(easy, CURLOPT_WRITEDATA, stdout);
+			curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, nullptr);
+			curl_easy_setopt(easy, CURLOPT_HEADERDATA, nullptr);
+			if (timings) {
+				timings->add(*handle, res);
+			}
+			try {
+				handle->checkCurlCode(res);
+			}
+			catch (...) {
+				completion(std::current_exception(), {});
+				return;
+			}
+			handle->getinfo(CURLINFO_RESPONSE_CODE, response.status);
+			completion({}, std::move(response));
+		}
+
+	private:
+		static size_t
+		recv(void * data, size_t sz, size_t nm, void * self)
+		{
+			static_cast<Transfer *>(self)->response.body.append(static_cast<const char *>(data), sz * nm);
+			return sz * nm;
+		}
+
+		static size_t
+		header(void * data, size_t sz, size_t nm, void * self)
+		{
+			auto & headers = static_cast<Transfer *>(self)->response.headers;
+			const std::string_view line {static_cast<const char *>(data), sz * nm};
+			if (boost::algorithm::starts_with(line, "HTTP/")) {
+				// A new response (after a redirect or 100 Continue); only the last one's headers are kept
+				headers.clear();
+			}
+			else if (const auto colon = line.find(':'); colon != std::string_view::npos) {
+				headers.emplace(boost::algorithm::trim_copy(std::string {line.substr(0, colon)}),
+						boost::algorithm::trim_copy(std::string {line.substr(colon + 1)}));
+			}
+			return sz * nm;
+		}
+
+		const CurlHandlePtr handle;
+		const Completion completion;
+		CurlResponse response;
+	};
+
+	CurlClient::Awaitable::Awaitable(CurlClient & c, CurlHandlePtr h) : client {c}, handle {std::move(h)} { }
+
+	void
+	CurlClient::Awaitable::await_suspend(std::coroutine_handle<> coroutine)
+	{
+		// Members aren't touched after submission, as the coroutine may already have been resumed
+		client.fetch(std::move(handle), [this, coroutine](std::exception_ptr e, CurlResponse r) {
+			error = std::move(e);
+			response = std::move(r);
+			coroutine.resume();
+		});
+	}
+
+	CurlResponse
+	CurlClient::Awaitable::await_resume()
+	{
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return std::move(response);
+	}
+
+	CurlClient::CurlClient(const CurlMultiHandle::Limits & l, CurlTimingsPtr t) :
+		limits {l}, timings {std::move(t)}, wake {eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+	{
+		if (wake < 0) {
+			throw SystemException("eventfd(2) failed", strerror(errno), errno);
+		}
+		thread = std::thread {&CurlClient::run, this};
+	}
+
+	CurlClient::~CurlClient()
+	{
+		{
+			std::lock_guard<std::mutex> g {lock};
+			stopping = true;
+		}
+		const uint64_t one = 1;
+		[[maybe_unused]] const auto w = ::write(wake, &one, sizeof(one));
+		thread.join();
+	}
+
+	void
+	CurlClient::fetch(CurlHandlePtr handle, Completion completion)
+	{
+		auto transfer = std::make_unique<Transfer>(std::move(handle), std::move(completion));
+		{
+			std::lock_guard<std::mutex> g {lock};
+			if (!stopped) {
+				submitted.push_back(std::move(transfer));
+				const uint64_t one = 1;
+				[[maybe_unused]] const auto w = ::write(wake, &one, sizeof(one));
+				return;
+			}
+		}
+		transfer->finished(CURLE_ABORTED_BY_CALLBACK);
+	}
+
+	std::future<CurlResponse>
+	CurlClient::fetch(CurlHandlePtr handle)
+	{
+		auto promise = std::make_shared<std::promise<CurlResponse>>();
+		auto future = promise->get_future();
+		fetch(std::move(handle), [promise](std::exception_ptr e, CurlResponse r) {
+			if (e) {
+				promise->set_exception(std::move(e));
+			}
+			else {
+				promise->set_value(std::move(r));
+			}
+		});
+		return future;
+	}
+
+	std::future<CurlResponse>
+	CurlClient::fetch(const std::string & url)
+	{
+		return fetch(handleFor(url));
+	}
+
+	CurlClient::Awaitable
+	CurlClient::fetchAsync(CurlHandlePtr handle)
+	{
+		return {*this, std::move(handle)};
+	}
+
+	CurlClient::Awaitable
+	CurlClient::fetchAsync(const std::string & url)
+	{
+		return {*this, handleFor(url)};
+	}
+
+	CurlHandlePtr
+	CurlClient::handleFor(const std::string & url)
+	{
+		auto handle = std::make_shared<CurlHandle>(url);
+		handle->setopt(CURLOPT_FAILONERROR, 0L);
+		return handle;
+	}
+
+	void
+	CurlClient::run()
+	{
+		Handle curlm {curl_multi_init(), &curl_multi_cleanup};
+		CurlEvents events {curlm.get(), wake};
+		CurlConcurrency concurrency {limits};
+		if (limits.hostConnections) {
+			curl_multi_setopt(curlm.get(), CURLMOPT_MAX_HOST_CONNECTIONS, limits.hostConnections);
+		}
+		if (limits.totalConnections) {
+			curl_multi_setopt(curlm.get(), CURLMOPT_MAX_TOTAL_CONNECTIONS, limits.totalConnections);
+		}
+
+		std::deque<TransferPtr> waiting;
+		std::map<CURL *, TransferPtr> running;
+		while (true) {
+			{
+				std::lock_guard<std::mutex> g {lock};
+				if (stopping) {
+					break;
+				}
+				std::move(submitted.begin(), submitted.end(), std::back_inserter(waiting));
+				submitted.clear();
+			}
+			while (!waiting.empty() && running.size() < concurrency.limit()) {
+				auto & transfer = waiting.front();
+				transfer->start(curlm.get());
+				running.emplace(transfer->easy(), std::move(transfer));
+				waiting.pop_front();
+			}
+			events.wait();
+			CURLMsg * msg;
+			int msgs = 0;
+			while ((msg = curl_multi_info_read(curlm.get(), &msgs))) {
+				if (msg->msg == CURLMSG_DONE) {
+					// msg does not survive curl_multi_remove_handle
+					const auto easy = msg->easy_handle;
+					const auto result = msg->data.result;
+					curl_multi_remove_handle(curlm.get(), easy);
+					concurrency.completed(easy);
+					auto node = running.extract(easy);
+					node.mapped()->finished(result, timings.get());
+				}
+			}
+		}
+
+		// Abandon everything outstanding, including anything submitted by completions as they're abandoned
+		for (auto & r : running) {
+			curl_multi_remove_handle(curlm.get(), r.first);
+			r.second->finished(CURLE_ABORTED_BY_CALLBACK);
+		}
+		for (auto & w : waiting) {
+			w->finished(CURLE_ABORTED_BY_CALLBACK);
+		}
+		while (true) {
+			std::vector<TransferPtr> abandon;
+			{
+				std::lock_guard<std::mutex> g {lock};
+				if (submitted.empty()) {
+					stopped = true;
+					break;
+				}
+				abandon.swap(submitted);
+			}
+			for (auto & a : abandon) {
+				a->finished(CURLE_ABORTED_BY_CALLBACK);
+			}
+		}
+	}
+}
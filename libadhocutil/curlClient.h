@@ -0,0 +1,101 @@
+#pragma once
+
+#include "c++11Helpers.h"
+#include "case_less.h"
+#include "curlHandle.h"
+#include "curlMultiHandle.h"
+#include "curlTimings.h"
+#include "fileUtils.h"
+#include "visibility.h"
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace AdHoc::Net {
+	/// The outcome of an HTTP transfer.
+	struct DLL_PUBLIC CurlResponse {
+		/// The status code (CURLINFO_RESPONSE_CODE).
+		long status {};
+		/// The headers of the final response (after any redirects), by case-insensitive name.
+		std::multimap<std::string, std::string, case_less> headers;
+		/// The body.
+		std::string body;
+	};
+
+	/// Asynchronous HTTP client.
+	/** Transfers can be submitted at any time, from any thread. One background thread performs them all, on one
+	 * multi handle, so connections are reused between them. Completions run on that thread, so must not block. */
+	class DLL_PUBLIC CurlClient {
+	public:
+		/** Called once a transfer has finished, with either the error or the response. */
+		using Completion = std::function<void(std::exception_ptr, CurlResponse)>;
+
+		/// co_await support for a transfer. The awaiting coroutine is resumed on the client's thread.
+		class DLL_PUBLIC Awaitable {
+		public:
+			/// @cond
+			Awaitable(CurlClient &, CurlHandlePtr);
+
+			[[nodiscard]] bool
+			await_ready() const noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<>);
+			CurlResponse await_resume();
+			/// @endcond
+
+		private:
+			CurlClient & client;
+			CurlHandlePtr handle;
+			std::exception_ptr error;
+			CurlResponse response;
+		};
+
+		/** Start the client's thread, which performs transfers within the given limits, recording their timings
+		 * (optionally). */
+		explicit CurlClient(const CurlMultiHandle::Limits & = {}, CurlTimingsPtr timings = {});
+		/** Stop the client's thread. Transfers yet to complete fail with CURLE_ABORTED_BY_CALLBACK. */
+		~CurlClient();
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(CurlClient);
+
+		/** Perform the given transfer, calling the completion once it has finished. The handle's write and header
+		 * functions are replaced, and it mustn't be used elsewhere until then; they're reset to libcurl's
+		 * defaults (writing to stdout, no header function) before the completion is called, after which the
+		 * handle can be reused. */
+		void fetch(CurlHandlePtr, Completion);
+		/** Perform the given transfer. */
+		[[nodiscard]] std::future<CurlResponse> fetch(CurlHandlePtr);
+		/** Fetch the given URL. HTTP error statuses are returned in the response rather than failing. */
+		[[nodiscard]] std::future<CurlResponse> fetch(const std::string & url);
+		/** Perform the given transfer, with co_await. */
+		[[nodiscard]] Awaitable fetchAsync(CurlHandlePtr);
+		/** Fetch the given URL, with co_await. HTTP error statuses are returned in the response rather than
+		 * failing. */
+		[[nodiscard]] Awaitable fetchAsync(const std::string & url);
+
+	private:
+		class Transfer;
+		using TransferPtr = std::unique_ptr<Transfer>;
+
+		DLL_PRIVATE void run();
+		DLL_PRIVATE static CurlHandlePtr handleFor(const std::string & url);
+
+		const CurlMultiHandle::Limits limits;
+		const CurlTimingsPtr timings;
+		std::mutex lock;
+		std::vector<TransferPtr> submitted;
+		bool stopping {false}, stopped {false};
+		FileUtils::FileHandle wake;
+		std::thread thread;
+	};
+}
@@ -0,0 +1,150 @@
+#include "curlDecoding.h"
+#include "scopeExit.h"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/core/ref.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace AdHoc::Net {
+	ContentEncoding
+	contentEncoding(std::string_view name)
+	{
+		using boost::algorithm::iequals;
+		if (name.empty() || iequals(name, "identity")) {
+			return ContentEncoding::Identity;
+		}
+		if (iequals(name, "gzip") || iequals(name, "x-gzip")) {
+			return ContentEncoding::Gzip;
+		}
+		if (iequals(name, "deflate")) {
+			return ContentEncoding::Deflate;
+		}
+		if (iequals(name, "zstd")) {
+			return ContentEncoding::Zstd;
+		}
+		throw std::invalid_argument("Unsupported content encoding: " + std::string {name});
+	}
+
+	CurlDecodingStream::CurlDecodingStream(CurlStreamSource & source, ContentEncoding encoding)
+	{
+		pushDecoder(encoding);
+		push(boost::ref(source));
+	}
+
+	CurlDecodingStream::CurlDecodingStream(std::istream & source, ContentEncoding encoding)
+	{
+		pushDecoder(encoding);
+		push(source);
+	}
+
+	CurlDecodingStream::~CurlDecodingStream() = default;
+
+	void
+	CurlDecodingStream::pushDecoder(ContentEncoding encoding)
+	{
+		switch (encoding) {
+			case ContentEncoding::Identity:
+				break;
+			case ContentEncoding::Gzip:
+				push(boost::iostreams::gzip_decompressor {});
+				break;
+			case ContentEncoding::Deflate:
+				// As in HTTP, deflate is the zlib format (RFC 1950)
+				push(boost::iostreams::zlib_decompressor {});
+				break;
+			case ContentEncoding::Zstd:
+				push(boost::iostreams::zstd_decompressor {});
+				break;
+		}
+	}
+
+	CurlRecordReader::CurlRecordReader(Reader r, char d, size_t bufferSize) :
+		reader {std::move(r)}, delimiter {d}, buffer(bufferSize)
+	{
+	}
+
+	CurlRecordReader::CurlRecordReader(CurlStreamSource & source, char d, size_t bufferSize) :
+		CurlRecordReader {[&source](char * target, std::streamsize size) {
+							  return source.read(target, size);
+						  },
+				d, bufferSize}
+	{
+	}
+
+	CurlRecordReader::CurlRecordReader(std::istream & source, char d, size_t bufferSize) :
+		CurlRecordReader {[&source](char * target, std::streamsize size) {
+							  // Have istream rethrow errors from the underlying source, rather than just set badbit
+							  const auto mask = source.exceptions();
+							  source.exceptions(mask | std::ios_base::badbit);
+							  ScopeExit restore {[&source, mask] {
+								  source.exceptions(mask);
+							  }};
+							  source.read(target, size);
+							  return source.gcount();
+						  },
+				d, bufferSize}
+	{
+	}
+
+	std::optional<std::string_view>
+	CurlRecordReader::next()
+	{
+		while (true) {
+			if (const auto delim = static_cast<const char *>(
+						memchr(buffer.data() + scanned, delimiter, end - scanned))) {
+				const auto pos = static_cast<size_t>(delim - buffer.data());
+				const std::string_view record {buffer.data() + begin, pos - begin};
+				begin = scanned = pos + 1;
+				return record;
+			}
+			scanned = end;
+			if (!fill()) {
+				if (begin == end) {
+					return {};
+				}
+				// Undelimited last record
+				const std::string_view record {buffer.data() + begin, end - begin};
+				begin = scanned = end;
+				return record;
+			}
+		}
+	}
+
+	bool
+	CurlRecordReader::fill()
+	{
+		if (eof) {
+			return false;
+		}
+		if (begin == end) {
+			// Everything's been consumed; start again at the front
+			begin = end = scanned = 0;
+		}
+		else if (end == buffer.size()) {
+			if (begin) {
+				// Move the partial record to the front to make room
+				std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+				end -= begin;
+				scanned -= begin;
+				begin = 0;
+			}
+			else {
+				// A record longer than the buffer
+				buffer.resize(buffer.size() * 2);
+			}
+		}
+		const auto got = reader(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+		if (got <= 0) {
+			eof = true;
+			return false;
+		}
+		end += static_cast<size_t>(got);
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "c++11Helpers.h"
+#include "curlStream.h"
+#include "visibility.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace AdHoc::Net {
+	/// Encodings a response's content can be decoded from.
+	enum class ContentEncoding { Identity, Gzip, Deflate, Zstd };
+
+	/** The encoding with the given name, as in a Content-Encoding header (case-insensitive, with x-gzip as gzip).
+	 * @throws std::invalid_argument for any other name. */
+	DLL_PUBLIC ContentEncoding contentEncoding(std::string_view name);
+
+	/// Stream of content decoded as it's read, for when libcurl can't do the decoding itself; that is, when the
+	/// content's encoding isn't declared in a Content-Encoding header, e.g. a compressed file fetched by file://
+	/// URL. Otherwise, set CURLOPT_ACCEPT_ENCODING and libcurl decodes the content before it's received.
+	class DLL_PUBLIC CurlDecodingStream : public boost::iostreams::filtering_istream {
+	public:
+		/** Decode the content read from the given source. */
+		CurlDecodingStream(CurlStreamSource &, ContentEncoding);
+		/** Decode the content read from the given stream (e.g. as passed to a CurlMultiHandle::Consumer). */
+		CurlDecodingStream(std::istream &, ContentEncoding);
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(CurlDecodingStream);
+		~CurlDecodingStream() override;
+
+	private:
+		DLL_PRIVATE void pushDecoder(ContentEncoding);
+	};
+
+	/// Splits content into records, each ended by a delimiter (e.g. lines). Each record is returned as a view of
+	/// the reader's buffer, so is only copied when it spans the end of the buffer.
+	class DLL_PUBLIC CurlRecordReader {
+	public:
+		/** Reads up to the given number of bytes into the given buffer, returning how many were read; 0 or -1 at
+		 * the end of the content. */
+		using Reader = std::function<std::streamsize(char *, std::streamsize)>;
+
+		/** Split the content read by the given reader. */
+		explicit CurlRecordReader(Reader, char delimiter = '\n', size_t bufferSize = DEFAULT_BUFFER_SIZE);
+		/** Split the content read directly from the given source, bypassing any stream buffering. */
+		explicit CurlRecordReader(CurlStreamSource &, char delimiter = '\n', size_t bufferSize = DEFAULT_BUFFER_SIZE);
+		/** Split the content read from the given stream. Errors reading the stream are rethrown. */
+		explicit CurlRecordReader(std::istream &, char delimiter = '\n', size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+		/** The next record, without its delimiter, valid until the next call; or nothing after the last. The last
+		 * record needn't be delimited. */
+		std::optional<std::string_view> next();
+
+		/// Default buffer size, several of libcurl's largest writes.
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 4 * CURL_MAX_WRITE_SIZE;
+
+	private:
+		DLL_PRIVATE bool fill();
+
+		const Reader reader;
+		const char delimiter;
+		std::vector<char> buffer;
+		size_t begin {0}, end {0}, scanned {0};
+		bool eof {false};
+	};
+}
@@ -0,0 +1,151 @@
+#include "curlEvents.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <sys.h>
+#include <unistd.h>
+
+namespace AdHoc::Net {
+	CurlEvents::CurlEvents(CURLM * m, int w) : curlm {m}, wake {w}, epoll {epoll_create1(EPOLL_CLOEXEC)}
+	{
+		if (epoll < 0) {
+			throw SystemException("epoll_create1(2) failed", strerror(errno), errno);
+		}
+		if (wake >= 0) {
+			epoll_event e {};
+			e.events = EPOLLIN;
+			e.data.fd = wake;
+			epoll_ctl(epoll, EPOLL_CTL_ADD, wake, &e);
+		}
+		curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, &CurlEvents::socket);
+		curl_multi_setopt(curlm, CURLMOPT_SOCKETDATA, this);
+		curl_multi_setopt(curlm, CURLMOPT_TIMERFUNCTION, &CurlEvents::timer);
+		curl_multi_setopt(curlm, CURLMOPT_TIMERDATA, this);
+	}
+
+	CurlEvents::~CurlEvents()
+	{
+		curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, nullptr);
+		curl_multi_setopt(curlm, CURLMOPT_TIMERFUNCTION, nullptr);
+	}
+
+	void
+	CurlEvents::wait(std::chrono::steady_clock::time_point until)
+	{
+		int timeout = -1;
+		if (deadline) {
+			until = std::min(until, *deadline);
+		}
+		if (until != std::chrono::steady_clock::time_point::max()) {
+			timeout = static_cast<int>(std::max(
+					std::chrono::ceil<std::chrono::milliseconds>(until - std::chrono::steady_clock::now()).count(),
+					std::chrono::milliseconds::rep {0}));
+		}
+		const auto n = epoll_wait(epoll, ready.data(), static_cast<int>(ready.size()), timeout);
+		if (n < 0) {
+			if (errno == EINTR) {
+				return;
+			}
+			throw SystemException("epoll_wait(2) failed", strerror(errno), errno);
+		}
+		int running {};
+		for (const auto & e : std::span {ready.data(), static_cast<size_t>(n)}) {
+			if (e.data.fd == wake) {
+				// Just drain it; whoever woke us has queued work for the caller
+				uint64_t count {};
+				[[maybe_unused]] const auto r = ::read(wake, &count, sizeof(count));
+				continue;
+			}
+			const auto flags = ((e.events & EPOLLIN) ? CURL_CSELECT_IN : 0)
+					| ((e.events & EPOLLOUT) ? CURL_CSELECT_OUT : 0)
+					| ((e.events & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0);
+			curl_multi_socket_action(curlm, e.data.fd, flags, &running);
+		}
+		// Timeouts are serviced even when sockets are busy
+		if (deadline && *deadline <= std::chrono::steady_clock::now()) {
+			deadline.reset();
+			curl_multi_socket_action(curlm, CURL_SOCKET_TIMEOUT, 0, &running);
+		}
+	}
+
+	int
+	CurlEvents::socket(CURL *, curl_socket_t s, int what, void * self, void *)
+	{
+		const int epoll = static_cast<CurlEvents *>(self)->epoll;
+		if (what == CURL_POLL_REMOVE) {
+			epoll_ctl(epoll, EPOLL_CTL_DEL, s, nullptr);
+			return 0;
+		}
+		epoll_event e {};
+		e.events = ((what & CURL_POLL_IN) ? EPOLLIN : 0U) | ((what & CURL_POLL_OUT) ? EPOLLOUT : 0U);
+		e.data.fd = s;
+		if (epoll_ctl(epoll, EPOLL_CTL_MOD, s, &e) && errno == ENOENT) {
+			epoll_ctl(epoll, EPOLL_CTL_ADD, s, &e);
+		}
+		return 0;
+	}
+
+	int
+	CurlEvents::timer(CURLM *, long timeoutMs, void * self)
+	{
+		auto & deadline = static_cast<CurlEvents *>(self)->deadline;
+		if (timeoutMs < 0) {
+			deadline.reset();
+		}
+		else {
+			deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds {timeoutMs};
+		}
+		return 0;
+	}
+
+	CurlConcurrency::CurlConcurrency(const CurlMultiHandle::Limits & l) :
+		min {std::max<size_t>(1, std::min(l.minTransfers, l.transfers))}, max {std::max<size_t>(1, l.transfers)},
+		adaptive {l.adaptive}, target {adaptive ? std::clamp(START, min, max) : max}
+	{
+	}
+
+	size_t
+	CurlConcurrency::limit() const
+	{
+		return target;
+	}
+
+	void
+	CurlConcurrency::completed(CURL * easy)
+	{
+		if (!adaptive) {
+			return;
+		}
+		curl_off_t size {}, time {};
+		curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &size);
+		curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &time);
+		window.bytes += static_cast<double>(size);
+		window.latency += static_cast<double>(time);
+		window.transfers += 1;
+		const auto now = std::chrono::steady_clock::now();
+		// A window spans at least one full generation of transfers, and long enough to measure
+		if (window.transfers < target || now - window.start < MIN_WINDOW) {
+			return;
+		}
+		const Sample sample {(window.bytes + static_cast<double>(window.transfers))
+						/ std::chrono::duration<double>(now - window.start).count(),
+				window.latency / static_cast<double>(window.transfers)};
+		if (last) {
+			if (sample.throughput < last->throughput * (1 - TOLERANCE)) {
+				// Worse: last move was a mistake
+				growing = !growing;
+			}
+			else if (sample.throughput <= last->throughput * (1 + TOLERANCE)
+					&& sample.latency > last->latency * (1 + TOLERANCE)) {
+				// No better, just slower: saturated
+				growing = false;
+			}
+		}
+		last = sample;
+		target = std::clamp(
+				growing ? target + std::max<size_t>(1, target / 2) : target - std::max<size_t>(1, target / 4), min, max);
+		window = {now};
+	}
+}
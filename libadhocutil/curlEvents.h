@@ -0,0 +1,71 @@
+#pragma once
+
+#include "c++11Helpers.h"
+#include "curlMultiHandle.h"
+#include "fileUtils.h"
+#include "visibility.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <curl/curl.h>
+#include <optional>
+#include <sys/epoll.h>
+
+namespace AdHoc::Net {
+	/// Watches, with epoll(7), the sockets and timeout libcurl asks for via its socket and timer callbacks,
+	/// and passes readiness back to it with curl_multi_socket_action.
+	class DLL_PRIVATE CurlEvents {
+	public:
+		/** Drive the given multi handle, optionally also waking when wake (an eventfd) is signalled. */
+		explicit CurlEvents(CURLM *, int wake = -1);
+		~CurlEvents();
+		SPECIAL_MEMBERS_DELETE(CurlEvents);
+
+		/// Wait for socket activity, libcurl's timeout, a wake or until, and perform whatever is now possible.
+		void wait(std::chrono::steady_clock::time_point until = std::chrono::steady_clock::time_point::max());
+
+	private:
+		static int socket(CURL *, curl_socket_t s, int what, void * self, void *);
+		static int timer(CURLM *, long timeoutMs, void * self);
+
+		CURLM * curlm;
+		const int wake;
+		FileUtils::FileHandle epoll;
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+		std::array<epoll_event, 64> ready {};
+	};
+
+	/// The number of transfers to have in progress; fixed, or adapted by hill climbing on the throughput
+	/// of each window of completed transfers.
+	class DLL_PRIVATE CurlConcurrency {
+	public:
+		explicit CurlConcurrency(const CurlMultiHandle::Limits &);
+
+		/// The number of transfers to have in progress now.
+		[[nodiscard]] size_t limit() const;
+		/// Account for a completed transfer.
+		void completed(CURL * easy);
+
+	private:
+		static constexpr size_t START = 5;
+		static constexpr double TOLERANCE = 0.05;
+		static constexpr auto MIN_WINDOW = std::chrono::milliseconds {20};
+
+		struct Sample {
+			double throughput, latency;
+		};
+
+		struct Window {
+			std::chrono::steady_clock::time_point start {std::chrono::steady_clock::now()};
+			double bytes {}, latency {};
+			size_t transfers {};
+		};
+
+		const size_t min, max;
+		const bool adaptive;
+		size_t target;
+		bool growing {true};
+		Window window;
+		std::optional<Sample> last;
+	};
+}
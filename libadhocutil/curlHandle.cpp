@@ -1,8 +1,13 @@
 #include "curlHandle.h"
+#include "buffer.h"
 #include "compileTimeFormatter.h"
 #include <Ice/Optional.h>
 #include <boost/numeric/conversion/cast.hpp>
+#include <cerrno>
+#include <istream>
 #include <net.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace AdHoc::Net {
 
@@ -13,6 +18,38 @@ namespace AdHoc::Net {
 		curl_global_cleanup();
 	}
 
+	CurlShare::CurlShare(std::initializer_list<curl_lock_data> data) : share(curl_share_init())
+	{
+		curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+		curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+		curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+		for (const auto d : data) {
+			curl_share_setopt(share, CURLSHOPT_SHARE, d);
+		}
+	}
+
+	CurlShare::~CurlShare()
+	{
+		curl_share_cleanup(share);
+	}
+
+	CurlShare::operator CURLSH *() const
+	{
+		return share;
+	}
+
+	void
+	CurlShare::lock(CURL *, curl_lock_data data, curl_lock_access, void * self)
+	{
+		static_cast<CurlShare *>(self)->locks.at(data).lock();
+	}
+
+	void
+	CurlShare::unlock(CURL *, curl_lock_data data, void * self)
+	{
+		static_cast<CurlShare *>(self)->locks.at(data).unlock();
+	}
+
 	CurlHandle::CurlHandle(const std::string & url) : curl_handle(curl_easy_init())
 	{
 		curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
@@ -30,6 +67,33 @@ namespace AdHoc::Net {
 		curl_easy_cleanup(curl_handle);
 	}
 
+	void
+	CurlHandle::reset(const std::string & url)
+	{
+		curl_easy_reset(curl_handle);
+		if (curl_headers) {
+			curl_slist_free_all(curl_headers);
+			curl_headers = nullptr;
+		}
+		if (mime) {
+			curl_mime_free(mime);
+			mime = nullptr;
+		}
+		body.reset();
+		curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+		curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
+		if (share) {
+			curl_easy_setopt(curl_handle, CURLOPT_SHARE, static_cast<CURLSH *>(*share));
+		}
+	}
+
+	void
+	CurlHandle::setShare(CurlSharePtr s)
+	{
+		share = std::move(s);
+		curl_easy_setopt(curl_handle, CURLOPT_SHARE, share ? static_cast<CURLSH *>(*share) : nullptr);
+	}
+
 	void
 	CurlHandle::getinfo(CURLINFO info, long & val) const
 	{
@@ -56,22 +120,186 @@ namespace AdHoc::Net {
 		curl_easy_getinfo(curl_handle, info, &val);
 	}
 
+	CurlTiming
+	CurlHandle::timing() const
+	{
+		const auto time = [this](CURLINFO info) {
+			curl_off_t us {};
+			curl_easy_getinfo(curl_handle, info, &us);
+			return std::chrono::microseconds {us};
+		};
+		const auto value = [this](CURLINFO info) {
+			curl_off_t v {};
+			curl_easy_getinfo(curl_handle, info, &v);
+			return v;
+		};
+		return {time(CURLINFO_NAMELOOKUP_TIME_T), time(CURLINFO_CONNECT_TIME_T), time(CURLINFO_APPCONNECT_TIME_T),
+				time(CURLINFO_PRETRANSFER_TIME_T), time(CURLINFO_STARTTRANSFER_TIME_T), time(CURLINFO_TOTAL_TIME_T),
+				time(CURLINFO_REDIRECT_TIME_T), value(CURLINFO_SIZE_DOWNLOAD_T), value(CURLINFO_SIZE_UPLOAD_T),
+				value(CURLINFO_SPEED_DOWNLOAD_T), value(CURLINFO_SPEED_UPLOAD_T)};
+	}
+
 	void
 	CurlHandle::appendHeader(const char * header)
 	{
 		curl_headers = curl_slist_append(curl_headers, header);
 	}
 
+	curl_mimepart *
+	CurlHandle::addPart(const char * name)
+	{
+		if (!mime) {
+			mime = curl_mime_init(curl_handle);
+			curl_easy_setopt(curl_handle, CURLOPT_MIMEPOST, mime);
+		}
+		auto part = curl_mime_addpart(mime);
+		curl_mime_name(part, name);
+		return part;
+	}
+
 	void
 	CurlHandle::appendPost(const char * name, const char * value)
 	{
-		if (auto part = curl_mime_addpart(mime)) {
-			curl_mime_name(part, name);
-			curl_mime_data(part, value, CURL_ZERO_TERMINATED);
-			curl_easy_setopt(curl_handle, CURLOPT_MIMEPOST, mime);
+		curl_mime_data(addPart(name), value, CURL_ZERO_TERMINATED);
+	}
+
+	void
+	CurlHandle::appendPost(const char * name, BodyReader reader, curl_off_t size, BodySeeker seeker)
+	{
+		auto part = addPart(name);
+		auto partBody = std::make_unique<Body>(Body {std::move(reader), std::move(seeker)});
+		// Ownership passes to the part, which frees it with freeBody
+		curl_mime_data_cb(part, size, &CurlHandle::readBody, &CurlHandle::seekBody, &CurlHandle::freeBody,
+				partBody.release());
+	}
+
+	void
+	CurlHandle::appendPostFile(const char * name, const std::filesystem::path & path)
+	{
+		curl_mime_filedata(addPart(name), path.c_str());
+	}
+
+	void
+	CurlHandle::setBody(BodyReader reader, curl_off_t size, BodySeeker seeker, BodyMethod method)
+	{
+		body = std::make_unique<Body>(Body {std::move(reader), std::move(seeker)});
+		curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, &CurlHandle::readBody);
+		curl_easy_setopt(curl_handle, CURLOPT_READDATA, body.get());
+		curl_easy_setopt(curl_handle, CURLOPT_SEEKFUNCTION, &CurlHandle::seekBody);
+		curl_easy_setopt(curl_handle, CURLOPT_SEEKDATA, body.get());
+		// Whichever of these is set last decides the method
+		switch (method) {
+			case BodyMethod::Post:
+				curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+				curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE_LARGE, size);
+				break;
+			case BodyMethod::Put:
+				curl_easy_setopt(curl_handle, CURLOPT_UPLOAD, 1L);
+				curl_easy_setopt(curl_handle, CURLOPT_INFILESIZE_LARGE, size);
+				break;
 		}
 	}
 
+	void
+	CurlHandle::setBody(std::istream & in, curl_off_t size, BodyMethod method)
+	{
+		const auto start = in.tellg();
+		BodySeeker seeker;
+		if (start != std::istream::pos_type(-1)) {
+			seeker = [&in, start](curl_off_t offset) {
+				in.clear();
+				return !in.seekg(start + offset).fail();
+			};
+		}
+		setBody(
+				[&in](char * buf, size_t len) -> size_t {
+					in.read(buf, static_cast<std::streamsize>(len));
+					if (in.bad()) {
+						return CURL_READFUNC_ABORT;
+					}
+					return static_cast<size_t>(in.gcount());
+				},
+				size, std::move(seeker), method);
+	}
+
+	void
+	CurlHandle::setBody(const Buffer & buffer, BodyMethod method)
+	{
+		auto offset = std::make_shared<size_t>(0);
+		setBody(
+				[&buffer, offset](char * buf, size_t len) {
+					const auto n = buffer.readto(buf, len, *offset);
+					*offset += n;
+					return n;
+				},
+				static_cast<curl_off_t>(buffer.length()),
+				[offset](curl_off_t o) {
+					*offset = static_cast<size_t>(o);
+					return true;
+				},
+				method);
+	}
+
+	void
+	CurlHandle::setBody(int fd, curl_off_t size, BodyMethod method)
+	{
+		const auto start = lseek(fd, 0, SEEK_CUR);
+		if (struct stat st {}; size < 0 && start >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+			size = st.st_size - start;
+		}
+		BodySeeker seeker;
+		if (start >= 0) {
+			seeker = [fd, start](curl_off_t offset) {
+				return lseek(fd, start + offset, SEEK_SET) >= 0;
+			};
+		}
+		setBody(
+				[fd](char * buf, size_t len) -> size_t {
+					// Straight into libcurl's buffer
+					while (true) {
+						if (const auto r = ::read(fd, buf, len); r >= 0) {
+							return static_cast<size_t>(r);
+						}
+						if (errno != EINTR) {
+							return CURL_READFUNC_ABORT;
+						}
+					}
+				},
+				size, std::move(seeker), method);
+	}
+
+	size_t
+	CurlHandle::readBody(char * buf, size_t sz, size_t nm, void * b)
+	{
+		try {
+			return static_cast<Body *>(b)->read(buf, sz * nm);
+		}
+		catch (...) {
+			return CURL_READFUNC_ABORT;
+		}
+	}
+
+	int
+	CurlHandle::seekBody(void * b, curl_off_t offset, int origin)
+	{
+		const auto & seek = static_cast<Body *>(b)->seek;
+		if (origin != SEEK_SET || !seek) {
+			return CURL_SEEKFUNC_CANTSEEK;
+		}
+		try {
+			return seek(offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+		}
+		catch (...) {
+			return CURL_SEEKFUNC_FAIL;
+		}
+	}
+
+	void
+	CurlHandle::freeBody(void * b)
+	{
+		const std::unique_ptr<Body> owned {static_cast<Body *>(b)};
+	}
+
 	void
 	CurlHandle::perform()
 	{
@@ -3,15 +3,94 @@
 #include "c++11Helpers.h"
 #include "visibility.h"
 #include <curl/curl.h> // IWYU pragma: export
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <iosfwd>
 #include <memory>
+#include <mutex>
 #include <string>
 
+namespace AdHoc {
+	class Buffer;
+}
+
 namespace AdHoc::Net {
 
+	/// libcurl share handle wrapper.
+	/** Shares caches (by default DNS, connections and TLS sessions) between the CurlHandles it is attached to,
+	 * so repeated requests to the same host reuse them. Safe for use across threads. */
+	class DLL_PUBLIC CurlShare {
+	public:
+		/**
+		 * Create a new CurlShare.
+		 * @param data The data to share (CURL_LOCK_DATA_*).
+		 */
+		explicit CurlShare(std::initializer_list<curl_lock_data> data
+				= {CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_CONNECT, CURL_LOCK_DATA_SSL_SESSION});
+		~CurlShare();
+		/// Standard move/copy support
+		SPECIAL_MEMBERS_DELETE(CurlShare);
+
+		/** Get the underlying CURLSH * handle. */
+		// NOLINTNEXTLINE(hicpp-explicit-conversions)
+		operator CURLSH *() const;
+
+	private:
+		DLL_PRIVATE static void lock(CURL *, curl_lock_data, curl_lock_access, void *);
+		DLL_PRIVATE static void unlock(CURL *, curl_lock_data, void *);
+
+		CURLSH * share;
+		std::array<std::mutex, CURL_LOCK_DATA_LAST> locks;
+	};
+	using CurlSharePtr = std::shared_ptr<CurlShare>;
+
+	/// Timing and size of a completed transfer, per libcurl's CURLINFO_*_T. Each time is from the start of the
+	/// transfer, to the end of that phase; phases not needed (e.g. when reusing a connection) take no time.
+	struct DLL_PUBLIC CurlTiming {
+		/// Name resolution complete.
+		std::chrono::microseconds nameLookup {};
+		/// Connected.
+		std::chrono::microseconds connect {};
+		/// TLS (or other application protocol) handshake complete; 0 if there wasn't one.
+		std::chrono::microseconds appConnect {};
+		/// About to start sending.
+		std::chrono::microseconds preTransfer {};
+		/// First byte of the response received.
+		std::chrono::microseconds startTransfer {};
+		/// Complete.
+		std::chrono::microseconds total {};
+		/// Spent on redirects before the final transfer began.
+		std::chrono::microseconds redirect {};
+		/// Bytes received.
+		curl_off_t downloaded {};
+		/// Bytes sent.
+		curl_off_t uploaded {};
+		/// Average bytes per second received.
+		curl_off_t downloadSpeed {};
+		/// Average bytes per second sent.
+		curl_off_t uploadSpeed {};
+	};
+
 	/// libcurl handle wrapper.
 	/** Wraps a libcurl CURL * object in a C++ friendly manner. */
 	class DLL_PUBLIC CurlHandle {
 	public:
+		/** Reads up to the given number of bytes of request body into the given buffer, returning the number read;
+		 * 0 at the end, or CURL_READFUNC_ABORT (or throw) to fail the transfer. */
+		using BodyReader = std::function<size_t(char *, size_t)>;
+		/** Repositions a request body to the given offset from its start, so it can be sent again. */
+		using BodySeeker = std::function<bool(curl_off_t)>;
+		/** How a request body is sent. */
+		enum class BodyMethod {
+			/** As a POST (CURLOPT_POST). */
+			Post,
+			/** As an upload (CURLOPT_UPLOAD): a PUT for HTTP. */
+			Put,
+		};
+
 		/**
 		 * Create a new CurlHandle.
 		 * @param url Set the required CURLOPT_URL property to the given url.
@@ -36,12 +115,50 @@ namespace AdHoc::Net {
 		void getinfo(CURLINFO info, double & val) const;
 		/** Get info for char * values */
 		void getinfo(CURLINFO info, char *& val) const;
+		/** Get the timing of the last transfer. */
+		[[nodiscard]] CurlTiming timing() const;
 		/** Append the given HTTP header */
 		void appendHeader(const char *);
 		/** Append the given HTTP post content */
 		void appendPost(const char *, const char *);
+		/**
+		 * Append HTTP post content read, as it's sent, from reader.
+		 * @param name The part name.
+		 * @param reader Source of the content.
+		 * @param size The content size, or -1 if unknown (the post is then sent chunked).
+		 * @param seeker Rewinds the content, if it might need sending again (after redirects, authentication, etc).
+		 */
+		void appendPost(const char * name, BodyReader reader, curl_off_t size = -1, BodySeeker seeker = {});
+		/** Append HTTP post content from the given file, read by libcurl as it's sent. */
+		void appendPostFile(const char * name, const std::filesystem::path &);
+		/**
+		 * Send a request body read, as it's sent, from reader. This sets the request method, overriding any
+		 * CURLOPT_POST or CURLOPT_UPLOAD set before.
+		 * @param reader Source of the body.
+		 * @param size The body size, or -1 if unknown (the body is then sent chunked).
+		 * @param seeker Rewinds the body, if it might need sending again (after redirects, authentication, etc).
+		 * @param method How to send the body.
+		 */
+		void setBody(BodyReader reader, curl_off_t size = -1, BodySeeker seeker = {},
+				BodyMethod method = BodyMethod::Post);
+		/** Send a request body read from the given stream (from its current position), which must outlive the
+		 * transfer. */
+		void setBody(std::istream &, curl_off_t size = -1, BodyMethod = BodyMethod::Post);
+		/** Send the given buffer as the request body, without copying it first; it must outlive the transfer. */
+		void setBody(const Buffer &, BodyMethod = BodyMethod::Post);
+		/** Send a request body read from the given file descriptor (e.g. a FileUtils::FileHandle) from its current
+		 * position, which must stay open for the transfer. Without a size, that of a regular file is used. */
+		void setBody(int fd, curl_off_t size = -1, BodyMethod = BodyMethod::Post);
 		/** Perform the CURL transfer. */
 		void perform();
+		/**
+		 * Reset all options, headers and post content, ready for reuse for a new transfer. Connections and
+		 * caches are kept, as is any share.
+		 * @param url Set the required CURLOPT_URL property to the given url.
+		 */
+		void reset(const std::string & url);
+		/** Attach (or with null, detach) a share, which is kept alive while attached. */
+		void setShare(CurlSharePtr);
 
 		/** Get the underlying CURL * handle. @warning Make changes at your own risk. */
 		// NOLINTNEXTLINE(hicpp-explicit-conversions)
@@ -49,12 +166,26 @@ namespace AdHoc::Net {
 
 	protected:
 		/// @cond
+		friend class CurlClient;
 		void checkCurlCode(CURLcode res) const;
 
+		struct Body {
+			BodyReader read;
+			BodySeeker seek;
+		};
+
 		CURL * curl_handle;
 		curl_slist * curl_headers {nullptr};
 		curl_mime *mime{nullptr};
+		CurlSharePtr share;
+		std::unique_ptr<Body> body;
 		/// @endcond
+
+	private:
+		DLL_PRIVATE curl_mimepart * addPart(const char * name);
+		DLL_PRIVATE static size_t readBody(char * buf, size_t sz, size_t nm, void * body);
+		DLL_PRIVATE static int seekBody(void * body, curl_off_t offset, int origin);
+		DLL_PRIVATE static void freeBody(void * body);
 	};
 	using CurlHandlePtr = std::shared_ptr<CurlHandle>;
 }
@@ -0,0 +1,31 @@
+#include "curlHandlePool.h"
+#include "resourcePool.impl.h"
+#include <utility>
+
+namespace AdHoc {
+	template class ResourcePool<Net::CurlHandle>;
+	template class ResourceHandle<Net::CurlHandle>;
+}
+
+namespace AdHoc::Net {
+	CurlHandlePool::CurlHandlePool(std::ptrdiff_t maxSize, std::size_t keep, CurlSharePtr s) :
+		ResourcePool<CurlHandle>(maxSize, keep), share(std::move(s))
+	{
+	}
+
+	ResourceHandle<CurlHandle>
+	CurlHandlePool::get(const std::string & url)
+	{
+		auto handle = get();
+		handle->reset(url);
+		return handle;
+	}
+
+	std::shared_ptr<CurlHandle>
+	CurlHandlePool::createResource() const
+	{
+		auto handle = std::make_shared<CurlHandle>(std::string {});
+		handle->setShare(share);
+		return handle;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "curlHandle.h"
+#include "resourcePool.h"
+#include "visibility.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace AdHoc::Net {
+
+	/// A pool of reusable CurlHandles.
+	/** Handles keep their connections and caches between uses, and are reset for each new transfer.
+	 * All handles in the pool are attached to the pool's CurlShare, if it has one. */
+	class DLL_PUBLIC CurlHandlePool : public ResourcePool<CurlHandle> {
+	public:
+		/**
+		 * Create a new CurlHandlePool.
+		 * @param maxSize The upper limit of how many handles can be in use at once.
+		 * @param keep The number of idle handles to keep for reuse.
+		 * @param share The share to attach to all handles (optional).
+		 */
+		CurlHandlePool(std::ptrdiff_t maxSize, std::size_t keep, CurlSharePtr share = {});
+
+		using ResourcePool<CurlHandle>::get;
+		/** Get a handle from the pool, reset ready for a transfer from the given URL. */
+		ResourceHandle<CurlHandle> get(const std::string & url);
+
+	protected:
+		/// @cond
+		std::shared_ptr<CurlHandle> createResource() const override;
+		/// @endcond
+
+	private:
+		CurlSharePtr share;
+	};
+}
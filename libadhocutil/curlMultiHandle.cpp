@@ -1,21 +1,150 @@
 #include "curlMultiHandle.h"
+#include "curlEvents.h"
 #include "curlStream.h"
+#include "runtimeContext.h"
 #include <boost/core/ref.hpp>
 #include <boost/core/typeinfo.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <handle.h>
 #include <map>
-#include <sys/select.h>
+#include <optional>
+#include <random>
+#include <set>
 #include <utility>
+#include <vector>
 
 namespace AdHoc::Net {
 
-	class RunningCurl : public CurlStreamSource {
+	/// A transfer whose consumer runs on its own stack. The consumer is resumed by the event loop once data has
+	/// arrived, or when the buffer fills, rather than for every chunk received. The transfer may be attempted more
+	/// than once, one after another (retries) or two at once (hedging), until one attempt starts receiving.
+	class RunningCurl : public boost::iostreams::source, public CurlHandle, System::RuntimeContext {
 	public:
 		RunningCurl(const std::string & url, std::function<void(std::istream &)> c) :
-			CurlStreamSource(url), consumer(std::move(c))
+			CurlHandle(url), consumer(std::move(c))
 		{
+			curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, &RunningCurl::recv);
+			curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, this);
 		}
 
+		~RunningCurl() override
+		{
+			if (hedge) {
+				curl_easy_cleanup(hedge);
+			}
+		}
+
+		SPECIAL_MEMBERS_DELETE(RunningCurl);
+
+		/// Start the consumer, which runs until it needs data.
+		void
+		start()
+		{
+			if (curl_headers) {
+				curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, curl_headers);
+			}
+			started = std::chrono::steady_clock::now();
+			resume();
+		}
+
+		/// Let the consumer process what has been received.
+		void
+		resume()
+		{
+			if (!hasCompleted()) {
+				swapContext();
+			}
+		}
+
+		/// Has data been received that the consumer hasn't had?
+		[[nodiscard]] bool
+		pending() const
+		{
+			return !buffer.empty() && !hasCompleted();
+		}
+
+		/// The attempt which has started receiving, if any; only it may finish the transfer.
+		[[nodiscard]] CURL *
+		receiving() const
+		{
+			return winner;
+		}
+
+		/// The other attempt to the given one, if hedged.
+		[[nodiscard]] CURL *
+		other(CURL * easy) const
+		{
+			if (!hedge) {
+				return nullptr;
+			}
+			return easy == hedge ? curl_handle : hedge;
+		}
+
+		/// Create a duplicate attempt.
+		CURL *
+		startHedge()
+		{
+			hedged = true;
+			hedge = curl_easy_duphandle(curl_handle);
+			curl_easy_setopt(hedge, CURLOPT_WRITEFUNCTION, &RunningCurl::recvHedge);
+			return hedge;
+		}
+
+		/// Prepare for a new attempt, after all previous ones have failed without receiving anything.
+		void
+		restart()
+		{
+			if (hedge) {
+				curl_easy_cleanup(hedge);
+				hedge = nullptr;
+			}
+			hedged = false;
+			started = std::chrono::steady_clock::now();
+		}
+
+		/// The given attempt has finished the transfer; if it's the hedge, make it this handle's own.
+		void
+		adopt(CURL * easy)
+		{
+			if (easy == hedge) {
+				std::swap(curl_handle, hedge);
+			}
+		}
+
+		/// The transfer is complete; let the consumer finish.
+		void
+		finished(CURLcode r)
+		{
+			res = r;
+			done = true;
+			resume();
+		}
+
+		std::streamsize
+		read(char * target, std::streamsize targetSize)
+		{
+			while (buffer.empty()) {
+				if (done) {
+					checkCurlCode(res);
+					return 0;
+				}
+				swapContext();
+			}
+			return static_cast<std::streamsize>(buffer.read(target, static_cast<size_t>(targetSize)));
+		}
+
+		/// When the current attempt started.
+		std::chrono::steady_clock::time_point started;
+		/// The number of the current attempt.
+		unsigned int attempt {1};
+		/// Has the current attempt been considered for hedging?
+		bool hedged {false};
+
+	private:
 		void
 		callback() override
 		{
@@ -24,73 +153,306 @@ namespace AdHoc::Net {
 			consumer(curlstrm);
 		}
 
-	private:
+		static size_t
+		recv(void * data, size_t sz, size_t nm, void * self)
+		{
+			auto rc = static_cast<RunningCurl *>(self);
+			return rc->receive(rc->curl_handle, static_cast<const char *>(data), sz * nm);
+		}
+
+		static size_t
+		recvHedge(void * data, size_t sz, size_t nm, void * self)
+		{
+			auto rc = static_cast<RunningCurl *>(self);
+			return rc->receive(rc->hedge, static_cast<const char *>(data), sz * nm);
+		}
+
+		size_t
+		receive(CURL * from, const char * data, size_t length)
+		{
+			if (winner && winner != from) {
+				// Lost the race; abandon this attempt
+				return 0;
+			}
+			winner = from;
+			if (!buffer.write(data, length)) {
+				// Full: the consumer must make room
+				resume();
+				buffer.reserve(length);
+				buffer.write(data, length);
+			}
+			// A consumer that has returned wants no more; abandon the transfer
+			return hasCompleted() ? 0 : length;
+		}
+
 		const std::function<void(std::istream &)> consumer;
+		CurlBuffer buffer;
+		CURL * hedge {nullptr};
+		CURL * winner {nullptr};
+		bool done {false};
+		CURLcode res {CURLE_OK};
 	};
 
 	CurlMultiHandle::CurlMultiHandle() = default;
 
+	CurlMultiHandle::CurlMultiHandle(const Limits & l) : limits {l} { }
+
 	CurlMultiHandle::~CurlMultiHandle() = default;
 
 	CurlHandlePtr
 	CurlMultiHandle::addCurl(const std::string & url, const std::function<void(std::istream &)> & c)
 	{
-		return *curls.insert(std::make_shared<RunningCurl>(url, c)).first;
+		auto runner = std::make_shared<RunningCurl>(url, c);
+		if (share) {
+			runner->setShare(share);
+		}
+		return *curls.insert(std::move(runner)).first;
 	}
 
-	void
-	CurlMultiHandle::addRunner(CURLM * curlm, Running & running, CurlMultiHandle::CURLs & curls)
-	{
-		auto runner = *curls.begin();
-		curl_multi_add_handle(curlm, *runner);
-		running[*runner] = runner;
-		runner->swapContext();
-		curls.erase(runner);
-	}
+	namespace {
+		using Clock = std::chrono::steady_clock;
 
-	void
-	CurlMultiHandle::performAll()
-	{
-		if (!curls.empty()) {
-			Running running;
-			CURLM * curlm = curl_multi_init();
+		/// Performs queued transfers, within the limits, retrying and hedging them as the policies allow.
+		class Scheduler {
+		public:
+			Scheduler(const CurlMultiHandle & cmh, std::set<RunningCurlPtr> & q) :
+				queued {q}, retry {cmh.retry}, hedging {cmh.hedging}, timings {cmh.timings.get()},
+				concurrency {cmh.limits}
+			{
+				if (cmh.limits.hostConnections) {
+					curl_multi_setopt(curlm.get(), CURLMOPT_MAX_HOST_CONNECTIONS, cmh.limits.hostConnections);
+				}
+				if (cmh.limits.totalConnections) {
+					curl_multi_setopt(curlm.get(), CURLMOPT_MAX_TOTAL_CONNECTIONS, cmh.limits.totalConnections);
+				}
+			}
 
-			while (!curls.empty() && running.size() < 5) {
-				addRunner(curlm, running, curls);
+			void
+			run()
+			{
+				fill();
+				while (inProgress) {
+					const auto hedgeAfter = hedgeDelay();
+					events.wait(nextDue(hedgeAfter));
+					const auto now = Clock::now();
+					startRetries(now);
+					if (hedgeAfter) {
+						startHedges(now, *hedgeAfter);
+					}
+					for (const auto & r : running) {
+						if (r.second->pending()) {
+							r.second->resume();
+						}
+					}
+					cancelLosers();
+					completed();
+				}
+			}
+
+		private:
+			void
+			fill()
+			{
+				while (!queued.empty() && inProgress < concurrency.limit()) {
+					auto runner = *queued.begin();
+					queued.erase(queued.begin());
+					inProgress += 1;
+					add(runner, *runner);
+					runner->start();
+				}
+			}
+
+			void
+			add(const RunningCurlPtr & runner, CURL * easy)
+			{
+				curl_multi_add_handle(curlm.get(), easy);
+				running.emplace(easy, runner);
 			}
-			int act = static_cast<int>(running.size());
-			while (act) {
-				while (curl_multi_perform(curlm, &act) == CURLM_CALL_MULTI_PERFORM) { }
-				// Has anything finished
+
+			void
+			remove(CURL * easy)
+			{
+				curl_multi_remove_handle(curlm.get(), easy);
+				running.erase(easy);
+			}
+
+			[[nodiscard]] std::optional<Clock::duration>
+			hedgeDelay() const
+			{
+				if (hedging.percentile <= 0) {
+					return {};
+				}
+				if (firstByte.count() < hedging.minSamples) {
+					return hedging.initialDelay;
+				}
+				return firstByte.percentile(hedging.percentile);
+			}
+
+			[[nodiscard]] static bool
+			awaitingHedge(CURL * easy, const RunningCurlPtr & runner)
+			{
+				return easy == *runner && !runner->hedged && !runner->receiving();
+			}
+
+			[[nodiscard]] Clock::time_point
+			nextDue(std::optional<Clock::duration> hedgeAfter) const
+			{
+				auto due = delayed.empty() ? Clock::time_point::max() : delayed.begin()->first;
+				if (hedgeAfter) {
+					for (const auto & r : running) {
+						if (awaitingHedge(r.first, r.second)) {
+							due = std::min(due, r.second->started + *hedgeAfter);
+						}
+					}
+				}
+				return due;
+			}
+
+			void
+			startRetries(Clock::time_point now)
+			{
+				while (!delayed.empty() && delayed.begin()->first <= now) {
+					auto runner = delayed.begin()->second;
+					delayed.erase(delayed.begin());
+					runner->restart();
+					add(runner, *runner);
+				}
+			}
+
+			void
+			startHedges(Clock::time_point now, Clock::duration after)
+			{
+				std::vector<RunningCurlPtr> due;
+				for (const auto & r : running) {
+					if (awaitingHedge(r.first, r.second) && r.second->started + after <= now) {
+						due.push_back(r.second);
+					}
+				}
+				for (const auto & runner : due) {
+					runner->hedged = true;
+					// Only requests without side effects or bodies can be sent twice
+					char * method {};
+					curl_easy_getinfo(static_cast<CURL *>(*runner), CURLINFO_EFFECTIVE_METHOD, &method);
+					if (method && (!strcmp(method, "GET") || !strcmp(method, "HEAD"))) {
+						add(runner, runner->startHedge());
+					}
+				}
+			}
+
+			void
+			cancelLosers()
+			{
+				std::vector<CURL *> losers;
+				for (const auto & r : running) {
+					if (const auto winner = r.second->receiving(); winner && winner != r.first) {
+						losers.push_back(r.first);
+					}
+				}
+				for (const auto loser : losers) {
+					remove(loser);
+				}
+			}
+
+			void
+			completed()
+			{
 				CURLMsg * msg;
 				int msgs = 0;
-				while ((msg = curl_multi_info_read(curlm, &msgs))) {
-					if (msg->msg == CURLMSG_DONE) {
-						curl_multi_remove_handle(curlm, msg->easy_handle);
-						auto ri = running.find(msg->easy_handle);
-						ri->second->res = msg->data.result;
-						ri->second->swapContext();
-						running.erase(ri);
-						if (!curls.empty()) {
-							addRunner(curlm, running, curls);
-							act += 1;
+				while ((msg = curl_multi_info_read(curlm.get(), &msgs))) {
+					if (msg->msg != CURLMSG_DONE) {
+						continue;
+					}
+					// msg does not survive curl_multi_remove_handle
+					const auto easy = msg->easy_handle;
+					const auto result = msg->data.result;
+					const auto runner = running.at(easy);
+					remove(easy);
+					if (const auto other = runner->other(easy); other && running.contains(other)) {
+						if (result != CURLE_OK && !runner->receiving()) {
+							// The other attempt may yet succeed
+							continue;
 						}
+						remove(other);
+					}
+					if (result == CURLE_OK) {
+						curl_off_t firstByteTime {};
+						curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &firstByteTime);
+						firstByte.add(std::chrono::microseconds {firstByteTime});
+					}
+					else if (!runner->receiving() && retryable(easy, result, runner->attempt)) {
+						runner->attempt += 1;
+						delayed.emplace(Clock::now() + backoff(runner->attempt), runner);
+						continue;
+					}
+					runner->adopt(easy);
+					concurrency.completed(*runner);
+					if (timings) {
+						timings->add(*runner, result);
+					}
+					runner->finished(result);
+					inProgress -= 1;
+					fill();
+				}
+			}
+
+			[[nodiscard]] bool
+			retryable(CURL * easy, CURLcode result, unsigned int attempt) const
+			{
+				if (attempt >= retry.attempts) {
+					return false;
+				}
+				if (result == CURLE_HTTP_RETURNED_ERROR) {
+					long status {};
+					curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+					if (!retry.statuses.contains(status)) {
+						return false;
 					}
 				}
-				// Wait for something to happen
-				fd_set r, w, e;
-				int maxfd = 0;
-				struct timeval to = {0, 100000};
-				// NOLINTNEXTLINE(hicpp-no-assembler)
-				FD_ZERO(&r);
-				// NOLINTNEXTLINE(hicpp-no-assembler)
-				FD_ZERO(&w);
-				// NOLINTNEXTLINE(hicpp-no-assembler)
-				FD_ZERO(&e);
-				curl_multi_fdset(curlm, &r, &w, &e, &maxfd);
-				select(act, &r, &w, &e, &to);
-			}
-			curl_multi_cleanup(curlm);
+				else if (!retry.results.contains(result)) {
+					return false;
+				}
+				char * method {};
+				curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_METHOD, &method);
+				return method && retry.methods.contains(method);
+			}
+
+			/// The delay before the given attempt: exponential, capped, and with full jitter.
+			[[nodiscard]] Clock::duration
+			backoff(unsigned int attempt)
+			{
+				const auto exponent = std::min(attempt - 2, 30U);
+				const auto delay = std::min(retry.backoff * (int64_t {1} << exponent), retry.maxBackoff);
+				if (!retry.jitter) {
+					return delay;
+				}
+				return std::chrono::milliseconds {
+						std::uniform_int_distribution<std::chrono::milliseconds::rep> {0, delay.count()}(random)};
+			}
+
+			std::set<RunningCurlPtr> & queued;
+			const CurlMultiHandle::Retry & retry;
+			const CurlMultiHandle::Hedging & hedging;
+			CurlTimings * const timings;
+			Handle<CURLM *, decltype(&curl_multi_cleanup)> curlm {curl_multi_init(), &curl_multi_cleanup};
+			CurlEvents events {curlm.get()};
+			CurlConcurrency concurrency;
+			/// Attempts in progress (a hedged transfer has two), by handle
+			std::map<CURL *, RunningCurlPtr> running;
+			/// Transfers to retry, by when
+			std::multimap<Clock::time_point, RunningCurlPtr> delayed;
+			/// Transfers started and not yet finished
+			size_t inProgress {0};
+			/// Times to first byte of successful attempts, for hedging
+			CurlHistogram firstByte;
+			std::minstd_rand random {std::random_device {}()};
+		};
+	}
+
+	void
+	CurlMultiHandle::performAll()
+	{
+		if (!curls.empty()) {
+			Scheduler {*this, curls}.run();
 		}
 	}
 
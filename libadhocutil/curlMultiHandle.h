@@ -2,7 +2,10 @@
 
 #include "c++11Helpers.h"
 #include "curlHandle.h"
+#include "curlTimings.h"
 #include "visibility.h"
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <iosfwd>
 #include <map>
@@ -20,7 +23,59 @@ namespace AdHoc::Net {
 		/** A function that should consume the inbound byte stream. */
 		using Consumer = std::function<void(std::istream &)>;
 
+		/** Limits on how much performAll() does at once. */
+		struct Limits {
+			/** Maximum number of transfers in progress at once. */
+			size_t transfers {5};
+			/** Maximum connections to any one host (CURLMOPT_MAX_HOST_CONNECTIONS); 0 for no limit. Transfers
+			 * waiting for a connection still count towards transfers. */
+			long hostConnections {0};
+			/** Maximum connections in total (CURLMOPT_MAX_TOTAL_CONNECTIONS); 0 for no limit. */
+			long totalConnections {0};
+			/** Vary the number of transfers in progress, between minTransfers and transfers, by observed
+			 * throughput and latency. */
+			bool adaptive {false};
+			/** Lower bound on transfers in progress when adaptive. */
+			size_t minTransfers {1};
+		};
+
+		/** When and how to retry failed transfers. Only transfers whose consumer has yet to receive anything are
+		 * retried. */
+		struct Retry {
+			/** Attempts in total, including the first; 1 for no retries. */
+			unsigned int attempts {1};
+			/** Delay before the first retry, doubling for each after. */
+			std::chrono::milliseconds backoff {100};
+			/** Upper limit on the delay before any retry. */
+			std::chrono::milliseconds maxBackoff {10000};
+			/** Pick each delay at random between zero and the above ("full jitter"), so retries of transfers
+			 * which failed together are spread out. */
+			bool jitter {true};
+			/** libcurl results worth retrying. */
+			std::set<CURLcode> results {CURLE_COULDNT_RESOLVE_HOST, CURLE_COULDNT_CONNECT, CURLE_OPERATION_TIMEDOUT,
+					CURLE_SEND_ERROR, CURLE_RECV_ERROR, CURLE_GOT_NOTHING, CURLE_PARTIAL_FILE, CURLE_HTTP2,
+					CURLE_HTTP2_STREAM};
+			/** HTTP statuses worth retrying (as failed with CURLOPT_FAILONERROR). */
+			std::set<long> statuses {408, 429, 500, 502, 503, 504};
+			/** Request methods safe to retry. */
+			std::set<std::string> methods {"GET", "HEAD", "OPTIONS", "DELETE"};
+		};
+
+		/** When to hedge slow transfers: issue a duplicate GET or HEAD request, taking whichever responds first
+		 * and cancelling the other. Hedges don't count towards Limits::transfers. */
+		struct Hedging {
+			/** Percentile (0-100) of the time to first byte of transfers so far, after which a transfer yet to
+			 * receive anything is hedged; 0 for no hedging. */
+			double percentile {0};
+			/** The delay to use until minSamples transfers have completed. */
+			std::chrono::milliseconds initialDelay {100};
+			/** Transfers to complete before the percentile is used. */
+			size_t minSamples {20};
+		};
+
 		CurlMultiHandle();
+		/** Construct with the given limits. */
+		explicit CurlMultiHandle(const Limits &);
 		~CurlMultiHandle();
 
 		/// Standard move/copy support
@@ -31,11 +86,19 @@ namespace AdHoc::Net {
 		/** Perform all queued operations. */
 		void performAll();
 
+		/** The limits applied by performAll(). */
+		Limits limits;
+		/** The retry policy applied by performAll(). */
+		Retry retry;
+		/** The hedging policy applied by performAll(). */
+		Hedging hedging;
+		/** A share to attach to every transfer added (optional), so connections and caches outlive performAll(). */
+		CurlSharePtr share;
+		/** Where to record the timing of every transfer performed (optional). */
+		CurlTimingsPtr timings;
+
 	private:
 		using CURLs = std::set<RunningCurlPtr>;
-		using Running = std::map<CURL *, RunningCurlPtr>;
-
-		DLL_PRIVATE void addRunner(CURLM * curlm, Running & running, CURLs & curls);
 
 		CURLs curls;
 	};
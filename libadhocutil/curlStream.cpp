@@ -1,32 +1,110 @@
 #include "curlStream.h"
 #include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <bit>
 #include <cstring>
 
 namespace AdHoc::Net {
 
-	CurlStreamSource::CurlStreamSource(const std::string & url) : CurlHandle(url)
+	CurlBuffer::CurlBuffer(size_t capacity) : storage(std::bit_ceil(std::max<size_t>(capacity, 1))) { }
+
+	size_t
+	CurlBuffer::size() const
+	{
+		return tail - head;
+	}
+
+	size_t
+	CurlBuffer::capacity() const
+	{
+		return storage.size();
+	}
+
+	bool
+	CurlBuffer::empty() const
+	{
+		return head == tail;
+	}
+
+	size_t
+	CurlBuffer::mask() const
+	{
+		return storage.size() - 1;
+	}
+
+	void
+	CurlBuffer::reserve(size_t capacity)
+	{
+		if (capacity > storage.size()) {
+			std::vector<char> bigger(std::bit_ceil(capacity));
+			const auto length = read(bigger.data(), size());
+			storage.swap(bigger);
+			head = 0;
+			tail = length;
+		}
+	}
+
+	bool
+	CurlBuffer::write(const char * data, size_t length)
+	{
+		if (length > capacity() - size()) {
+			return false;
+		}
+		// At most two copies, either side of the wrap
+		const auto start = tail & mask();
+		const auto first = std::min(length, storage.size() - start);
+		memcpy(storage.data() + start, data, first);
+		memcpy(storage.data(), data + first, length - first);
+		tail += length;
+		return true;
+	}
+
+	size_t
+	CurlBuffer::read(char * target, size_t length)
+	{
+		length = std::min(length, size());
+		const auto start = head & mask();
+		const auto first = std::min(length, storage.size() - start);
+		memcpy(target, storage.data() + start, first);
+		memcpy(target + first, storage.data(), length - first);
+		head += length;
+		return length;
+	}
+
+	CurlStreamSource::CurlStreamSource(const std::string & url) :
+		CurlHandle(url), local(boost::algorithm::istarts_with(url, "file:"))
 	{
 		curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, &CurlStreamSource::recvWrapper);
 		curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, this);
 	}
 
-	AdHoc::Net::CurlStreamSource::~CurlStreamSource() = default;
+	AdHoc::Net::CurlStreamSource::~CurlStreamSource()
+	{
+		if (multi) {
+			curl_multi_remove_handle(multi, curl_handle);
+			curl_multi_cleanup(multi);
+		}
+	}
 
 	std::streamsize
 	CurlStreamSource::read(char * target, std::streamsize targetSize)
 	{
-		if (!buflen) {
-			swapContext();
-			checkCurlCode(res);
-			if (!buflen) {
-				return 0;
+		if (buffer.empty()) {
+			// Nothing buffered: let the transfer write straight to the target
+			direct = target;
+			directSize = static_cast<size_t>(targetSize);
+			fill();
+			direct = nullptr;
+			if (const auto written = std::exchange(directUsed, 0)) {
+				return static_cast<std::streamsize>(written);
+			}
+			if (buffer.empty()) {
+				checkCurlCode(res);
+				// End of stream, as filters (e.g. decompressors) require, rather than just no data yet
+				return -1;
 			}
 		}
-		auto bytes = std::min(buflen, targetSize);
-		memcpy(target, buf, static_cast<size_t>(bytes));
-		buflen -= bytes;
-		buf += bytes;
-		return bytes;
+		return static_cast<std::streamsize>(buffer.read(target, static_cast<size_t>(targetSize)));
 	}
 
 	void
@@ -36,21 +114,75 @@ namespace AdHoc::Net {
 			curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, curl_headers);
 		}
 		res = curl_easy_perform(curl_handle);
+		done = true;
+	}
+
+	void
+	CurlStreamSource::fill()
+	{
+		if (local) {
+			if (!hasCompleted()) {
+				swapContext();
+			}
+			return;
+		}
+		if (!multi) {
+			if (curl_headers) {
+				curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, curl_headers);
+			}
+			multi = curl_multi_init();
+			curl_multi_add_handle(multi, curl_handle);
+		}
+		if (paused) {
+			paused = false;
+			curl_easy_pause(curl_handle, CURLPAUSE_CONT);
+		}
+		while (!done && !directUsed && buffer.empty()) {
+			int running {};
+			curl_multi_perform(multi, &running);
+			int msgs {};
+			while (const auto msg = curl_multi_info_read(multi, &msgs)) {
+				if (msg->msg == CURLMSG_DONE) {
+					res = msg->data.result;
+					done = true;
+				}
+			}
+			if (!done && !directUsed && buffer.empty()) {
+				curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+			}
+		}
 	}
 
 	size_t
 	CurlStreamSource::recvWrapper(void * data, size_t sz, size_t nm, void * css)
 	{
-		return static_cast<size_t>(
-				static_cast<CurlStreamSource *>(css)->recv(data, static_cast<std::streamsize>(sz * nm)));
+		return static_cast<CurlStreamSource *>(css)->recv(static_cast<const char *>(data), sz * nm);
 	}
 
-	std::streamsize
-	CurlStreamSource::recv(void * data, std::streamsize datalen)
+	size_t
+	CurlStreamSource::recv(const char * data, size_t datalen)
 	{
-		buf = static_cast<char *>(data);
-		buflen = datalen;
-		swapContext();
+		const auto toDirect = direct ? std::min(datalen, directSize - directUsed) : 0;
+		if (datalen - toDirect > buffer.capacity() - buffer.size()) {
+			if (local || (buffer.empty() && !toDirect)) {
+				// Can't pause, or larger than ever expected (e.g. raised CURLOPT_BUFFERSIZE)
+				buffer.reserve(buffer.size() + datalen - toDirect);
+			}
+			else {
+				// Full: libcurl will deliver this again once unpaused
+				paused = true;
+				return CURL_WRITEFUNC_PAUSE;
+			}
+		}
+		if (toDirect) {
+			memcpy(direct + directUsed, data, toDirect);
+			directUsed += toDirect;
+		}
+		buffer.write(data + toDirect, datalen - toDirect);
+		if (local) {
+			// Yield to the reader, which resumes us once it has consumed this chunk
+			swapContext();
+		}
 		return datalen;
 	}
 
@@ -9,13 +9,46 @@
 #include <cstddef>
 #include <iosfwd>
 #include <string>
+#include <vector>
 namespace boost {
 	template<class T> class reference_wrapper;
 }
 
 namespace AdHoc::Net {
 
+	/// FIFO of bytes between libcurl's write callback and a reader.
+	class DLL_PUBLIC CurlBuffer {
+	public:
+		/** Construct with the given capacity (rounded up to a power of 2). */
+		explicit CurlBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+		/** Bytes buffered. */
+		[[nodiscard]] size_t size() const;
+		/** Bytes that can be buffered without growing. */
+		[[nodiscard]] size_t capacity() const;
+		/** Is nothing buffered? */
+		[[nodiscard]] bool empty() const;
+		/** Grow (if required) to at least the given capacity, keeping the buffered bytes. */
+		void reserve(size_t capacity);
+		/** Buffer all of the given bytes if they fit, otherwise none. */
+		bool write(const char * data, size_t length);
+		/** Move up to length buffered bytes to target. @return the number of bytes moved. */
+		size_t read(char * target, size_t length);
+
+		/// Default capacity, several of libcurl's largest writes.
+		static constexpr size_t DEFAULT_CAPACITY = 4 * CURL_MAX_WRITE_SIZE;
+
+	private:
+		[[nodiscard]] size_t mask() const;
+
+		std::vector<char> storage;
+		size_t head {0}, tail {0};
+	};
+
 	/// boost::iostreams::source implementation for CURL downloads.
+	/** The transfer is driven on demand by read, on a private multi handle; received data is copied straight to
+	 * the reader's buffer where possible and otherwise buffered, pausing the transfer while the buffer is full.
+	 * libcurl can't pause file:// transfers, so those run on an alternate stack, yielding each chunk read. */
 	class DLL_PUBLIC CurlStreamSource :
 		public boost::iostreams::source,
 		public CurlHandle,
@@ -24,21 +57,24 @@ namespace AdHoc::Net {
 		/** Construct a new stream source for the given URL. */
 		explicit CurlStreamSource(const std::string & url);
 		/// Standard move/copy support
-		SPECIAL_MEMBERS_DEFAULT_MOVE_NO_COPY(CurlStreamSource);
+		SPECIAL_MEMBERS_DELETE(CurlStreamSource);
 		~CurlStreamSource() override;
 
 		/** Required member function for reading of the stream source by boost::iostreams::stream. */
 		std::streamsize read(char * target, std::streamsize targetSize);
 
 	private:
-		friend class CurlMultiHandle;
 		DLL_PRIVATE void callback() override;
-
+		DLL_PRIVATE void fill();
 		DLL_PRIVATE static size_t recvWrapper(void * data, size_t sz, size_t nm, void * css);
-		DLL_PRIVATE std::streamsize recv(void * data, std::streamsize datalen);
+		DLL_PRIVATE size_t recv(const char * data, size_t datalen);
 
-		std::streamsize buflen {0};
-		char * buf {nullptr};
+		CURLM * multi {nullptr};
+		CurlBuffer buffer;
+		char * direct {nullptr};
+		size_t directSize {0}, directUsed {0};
+		const bool local;
+		bool paused {false}, done {false};
 		CURLcode res {CURLE_OK};
 	};
 
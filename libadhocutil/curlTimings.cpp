@@ -0,0 +1,150 @@
+#include "curlTimings.h"
+#include "uriParse.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace AdHoc::Net {
+	void
+	CurlHistogram::add(std::chrono::microseconds sample)
+	{
+		sample = std::max(sample, std::chrono::microseconds {});
+		// Bucket n holds [2^(n-1), 2^n), bucket 0 holds 0
+		const auto bucket = static_cast<size_t>(64 - std::countl_zero(static_cast<uint64_t>(sample.count())));
+		counts[std::min(bucket, BUCKETS - 1)] += 1;
+		samples += 1;
+		shortest = std::min(shortest, sample);
+		longest = std::max(longest, sample);
+		sum += sample;
+	}
+
+	size_t
+	CurlHistogram::count() const
+	{
+		return samples;
+	}
+
+	std::chrono::microseconds
+	CurlHistogram::min() const
+	{
+		return samples ? shortest : std::chrono::microseconds {};
+	}
+
+	std::chrono::microseconds
+	CurlHistogram::max() const
+	{
+		return longest;
+	}
+
+	std::chrono::microseconds
+	CurlHistogram::mean() const
+	{
+		return samples ? sum / static_cast<std::chrono::microseconds::rep>(samples) : std::chrono::microseconds {};
+	}
+
+	std::chrono::microseconds
+	CurlHistogram::percentile(double p) const
+	{
+		const auto rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100 * static_cast<double>(samples)));
+		size_t seen = 0;
+		for (size_t b = 0; b < BUCKETS; ++b) {
+			seen += counts[b];
+			if (seen && seen >= rank) {
+				// No bound is better than the longest seen
+				return std::min(bucketLimit(b), longest);
+			}
+		}
+		return longest;
+	}
+
+	const CurlHistogram::Buckets &
+	CurlHistogram::buckets() const
+	{
+		return counts;
+	}
+
+	std::chrono::microseconds
+	CurlHistogram::bucketLimit(size_t bucket)
+	{
+		if (bucket >= BUCKETS - 1) {
+			return std::chrono::microseconds::max();
+		}
+		return std::chrono::microseconds {int64_t {1} << bucket};
+	}
+
+	namespace {
+		std::chrono::microseconds
+		phase(std::chrono::microseconds from, std::chrono::microseconds to)
+		{
+			return std::max(to - from, std::chrono::microseconds {});
+		}
+	}
+
+	void
+	CurlTimings::add(const CurlHandle & handle, CURLcode result)
+	{
+		std::string host;
+		char * url {};
+		handle.getinfo(CURLINFO_EFFECTIVE_URL, url);
+		if (UriView uri; url && uri.parse(url) == UriView::Error::None) {
+			host = uri.host;
+			if (uri.port) {
+				host += ':' + std::to_string(*uri.port);
+			}
+		}
+		add(host, handle.timing(), result);
+	}
+
+	void
+	CurlTimings::add(const std::string & host, const CurlTiming & timing, CURLcode result)
+	{
+		if (observer) {
+			observer(host, timing, result);
+		}
+		std::lock_guard<std::mutex> g {lock};
+		auto & h = byHost[host];
+		h.transfers += 1;
+		h.failures += (result != CURLE_OK);
+		h.downloaded += timing.downloaded;
+		h.uploaded += timing.uploaded;
+		h.nameLookup.add(timing.nameLookup);
+		h.connect.add(phase(timing.nameLookup, timing.connect));
+		if (timing.appConnect.count()) {
+			h.tls.add(phase(timing.connect, timing.appConnect));
+		}
+		h.wait.add(phase(timing.preTransfer, timing.startTransfer));
+		h.transfer.add(phase(timing.startTransfer, timing.total));
+		h.total.add(timing.total);
+	}
+
+	std::map<std::string, CurlHostTimings>
+	CurlTimings::hosts() const
+	{
+		std::lock_guard<std::mutex> g {lock};
+		return byHost;
+	}
+
+	void
+	CurlTimings::exportTo(const Exporter & exporter, bool reset)
+	{
+		std::map<std::string, CurlHostTimings> snapshot;
+		{
+			// Export outside the lock, so slow exporters don't hold up transfers
+			std::lock_guard<std::mutex> g {lock};
+			snapshot = reset ? std::exchange(byHost, {}) : byHost;
+		}
+		for (const auto & h : snapshot) {
+			exporter(h.first, h.second);
+		}
+	}
+
+	void
+	CurlTimings::clear()
+	{
+		std::lock_guard<std::mutex> g {lock};
+		byHost.clear();
+	}
+}
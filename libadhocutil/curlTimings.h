@@ -0,0 +1,101 @@
+#pragma once
+
+#include "curlHandle.h"
+#include "visibility.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace AdHoc::Net {
+	/// Histogram of durations, in power of 2 microsecond buckets.
+	class DLL_PUBLIC CurlHistogram {
+	public:
+		/// Number of buckets; the last collects everything from 2^30 microseconds (about 17.9 minutes) up.
+		static constexpr size_t BUCKETS = 32;
+		/// Sample counts by bucket.
+		using Buckets = std::array<size_t, BUCKETS>;
+
+		/** Add a sample. */
+		void add(std::chrono::microseconds);
+
+		/** The number of samples. */
+		[[nodiscard]] size_t count() const;
+		/** The shortest sample. */
+		[[nodiscard]] std::chrono::microseconds min() const;
+		/** The longest sample. */
+		[[nodiscard]] std::chrono::microseconds max() const;
+		/** The mean of the samples. */
+		[[nodiscard]] std::chrono::microseconds mean() const;
+		/** An upper bound (that of the bucket it falls in) on the given percentile (0-100) of the samples. */
+		[[nodiscard]] std::chrono::microseconds percentile(double) const;
+		/** Sample counts by bucket. */
+		[[nodiscard]] const Buckets & buckets() const;
+		/** The (exclusive) upper bound of the given bucket's range; it starts at the previous bucket's. */
+		[[nodiscard]] static std::chrono::microseconds bucketLimit(size_t bucket);
+
+	private:
+		Buckets counts {};
+		size_t samples {};
+		std::chrono::microseconds shortest {std::chrono::microseconds::max()}, longest {}, sum {};
+	};
+
+	/// Aggregated timings of the transfers to one host. Each histogram covers one phase, rather than the time
+	/// since the start, so where time goes can be told apart.
+	struct DLL_PUBLIC CurlHostTimings {
+		/// Number of transfers.
+		size_t transfers {};
+		/// Number of those which failed.
+		size_t failures {};
+		/// Total bytes received.
+		curl_off_t downloaded {};
+		/// Total bytes sent.
+		curl_off_t uploaded {};
+		/// Name resolution.
+		CurlHistogram nameLookup;
+		/// TCP connection, after name resolution.
+		CurlHistogram connect;
+		/// TLS handshake, after connection (when there is one).
+		CurlHistogram tls;
+		/// From sending the request, to the first byte of the response.
+		CurlHistogram wait;
+		/// Receiving the response, after its first byte.
+		CurlHistogram transfer;
+		/// Whole transfers.
+		CurlHistogram total;
+	};
+
+	/// Collects the timings of transfers, by host. Safe for use across threads.
+	class DLL_PUBLIC CurlTimings {
+	public:
+		/** Called with each transfer's host, timing and result as it's added. */
+		using Observer = std::function<void(const std::string & host, const CurlTiming &, CURLcode)>;
+		/** Called with each host and its aggregated timings, when exporting. */
+		using Exporter = std::function<void(const std::string & host, const CurlHostTimings &)>;
+
+		/** Add the timing of the given handle's completed transfer. */
+		void add(const CurlHandle &, CURLcode result = CURLE_OK);
+		/** Add a timing for the given host (host[:port]). */
+		void add(const std::string & host, const CurlTiming &, CURLcode result = CURLE_OK);
+
+		/** Get a copy of the timings so far, by host[:port] (empty for URLs without a host, such as file://). */
+		[[nodiscard]] std::map<std::string, CurlHostTimings> hosts() const;
+		/** Pass the timings of each host so far to exporter (e.g. to publish to monitoring), optionally resetting
+		 * them, so each export covers only the period since the last. */
+		void exportTo(const Exporter & exporter, bool reset = false);
+		/** Forget the timings so far. */
+		void clear();
+
+		/** Called for each transfer added (optional); set before adding any. */
+		Observer observer;
+
+	private:
+		mutable std::mutex lock;
+		std::map<std::string, CurlHostTimings> byHost;
+	};
+	using CurlTimingsPtr = std::shared_ptr<CurlTimings>;
+}
@@ -0,0 +1,229 @@
+#include "lexer-matchers.h"
+#include "c++11Helpers.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace AdHoc::LexerMatchers {
+	namespace {
+		class Matched : public Lexer::Pattern {
+		public:
+			size_t
+			matchedLength() const override
+			{
+				return len;
+			}
+
+			std::optional<std::string_view>
+			matchView(int n) const override
+			{
+				if (n == 0 && str) {
+					return std::string_view(str, len);
+				}
+				return {};
+			}
+
+		protected:
+			bool
+			matched(const gchar * string, size_t length) const
+			{
+				str = string;
+				len = length;
+				return length > 0;
+			}
+
+		private:
+			mutable const gchar * str {nullptr};
+			mutable size_t len {0};
+		};
+
+		class Literal : public Matched {
+		public:
+			explicit Literal(std::string_view l) : literal(l) { }
+
+			Lexer::PatternPtr
+			instance() const override
+			{
+				return std::make_shared<Literal>(*this);
+			}
+
+			bool
+			matches(const gchar * string, size_t length, size_t position) const override
+			{
+				if (length - position >= literal.length()
+						&& !std::memcmp(string + position, literal.data(), literal.length())) {
+					return matched(string + position, literal.length());
+				}
+				return matched(string + position, 0);
+			}
+
+			Lexer::PartialResult
+			matchesPartial(const gchar * string, size_t length, size_t position) const override
+			{
+				const auto available = std::min(length - position, literal.length());
+				if (std::memcmp(string + position, literal.data(), available)) {
+					return Lexer::PartialResult::NoMatch;
+				}
+				return matches(string, length, position) ? Lexer::PartialResult::Match : Lexer::PartialResult::NeedMore;
+			}
+
+		private:
+			const std::string literal;
+		};
+
+		class Literals : public Matched {
+		public:
+			explicit Literals(std::vector<std::string> literals) : byFirst(std::make_shared<ByFirst>())
+			{
+				std::sort(literals.begin(), literals.end(), [](const auto & a, const auto & b) {
+					return a.length() > b.length();
+				});
+				for (auto & l : literals) {
+					if (!l.empty()) {
+						(*byFirst)[static_cast<unsigned char>(l.front())].push_back(std::move(l));
+					}
+				}
+			}
+
+			Lexer::PatternPtr
+			instance() const override
+			{
+				return std::make_shared<Literals>(*this);
+			}
+
+			bool
+			matches(const gchar * string, size_t length, size_t position) const override
+			{
+				if (position < length) {
+					const auto remaining = length - position;
+					for (const auto & l : (*byFirst)[static_cast<unsigned char>(string[position])]) {
+						if (remaining >= l.length() && !std::memcmp(string + position, l.data(), l.length())) {
+							return matched(string + position, l.length());
+						}
+					}
+				}
+				return matched(string + position, 0);
+			}
+
+			Lexer::PartialResult
+			matchesPartial(const gchar * string, size_t length, size_t position) const override
+			{
+				if (position >= length) {
+					return Lexer::PartialResult::NeedMore;
+				}
+				// A longer candidate, of which the available input is a prefix, could yet match
+				const auto remaining = length - position;
+				for (const auto & l : (*byFirst)[static_cast<unsigned char>(string[position])]) {
+					if (remaining >= l.length()) {
+						break;
+					}
+					if (!std::memcmp(string + position, l.data(), remaining)) {
+						return Lexer::PartialResult::NeedMore;
+					}
+				}
+				return matches(string, length, position) ? Lexer::PartialResult::Match : Lexer::PartialResult::NoMatch;
+			}
+
+		private:
+			// Candidates by first byte, longest first; shared by instances
+			using ByFirst = std::array<std::vector<std::string>, 256>;
+			std::shared_ptr<ByFirst> byFirst;
+		};
+
+		class Class : public Matched {
+		public:
+			explicit Class(const CharClass & c) : chars(c) { }
+
+			Lexer::PatternPtr
+			instance() const override
+			{
+				return std::make_shared<Class>(*this);
+			}
+
+			bool
+			matches(const gchar * string, size_t length, size_t position) const override
+			{
+				return matched(string + position, (position < length && chars.contains(string[position])) ? 1 : 0);
+			}
+
+			Lexer::PartialResult
+			matchesPartial(const gchar * string, size_t length, size_t position) const override
+			{
+				if (position >= length) {
+					return Lexer::PartialResult::NeedMore;
+				}
+				return matches(string, length, position) ? Lexer::PartialResult::Match : Lexer::PartialResult::NoMatch;
+			}
+
+		private:
+			const CharClass chars;
+		};
+
+		class Run : public Matched {
+		public:
+			Run(const CharClass & f, const CharClass & r) : first(f), rest(r) { }
+
+			Lexer::PatternPtr
+			instance() const override
+			{
+				return std::make_shared<Run>(*this);
+			}
+
+			bool
+			matches(const gchar * string, size_t length, size_t position) const override
+			{
+				if (position < length && first.contains(string[position])) {
+					return matched(string + position, 1 + rest.span(string + position + 1, length - position - 1));
+				}
+				return matched(string + position, 0);
+			}
+
+			Lexer::PartialResult
+			matchesPartial(const gchar * string, size_t length, size_t position) const override
+			{
+				if (!matches(string, length, position)) {
+					return (position >= length) ? Lexer::PartialResult::NeedMore : Lexer::PartialResult::NoMatch;
+				}
+				// The run could continue into more input
+				return (position + matchedLength() < length) ? Lexer::PartialResult::Match
+															 : Lexer::PartialResult::NeedMore;
+			}
+
+		private:
+			const CharClass first, rest;
+		};
+	}
+
+	Lexer::PatternPtr
+	literal(std::string_view l)
+	{
+		return std::make_shared<Literal>(l);
+	}
+
+	Lexer::PatternPtr
+	literals(std::vector<std::string> l)
+	{
+		return std::make_shared<Literals>(std::move(l));
+	}
+
+	Lexer::PatternPtr
+	charClass(const CharClass & c)
+	{
+		return std::make_shared<Class>(c);
+	}
+
+	Lexer::PatternPtr
+	charRun(const CharClass & c)
+	{
+		return std::make_shared<Run>(c, c);
+	}
+
+	Lexer::PatternPtr
+	charRun(const CharClass & f, const CharClass & r)
+	{
+		return std::make_shared<Run>(f, r);
+	}
+}
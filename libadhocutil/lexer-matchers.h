@@ -0,0 +1,51 @@
+#pragma once
+
+#include "charClass.h" // IWYU pragma: export
+#include "lexer.h" // IWYU pragma: export
+#include "visibility.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace AdHoc::LexerMatchers {
+	/// Byte sets, as matched by the class matchers below.
+	using AdHoc::CharClass;
+
+	/**
+	 * Create a AdHoc::Lexer pattern matcher for a literal string.
+	 * @param literal The string to match.
+	 * @return Pointer to the newly created pattern matcher.
+	 */
+	DLL_PUBLIC Lexer::PatternPtr literal(std::string_view literal);
+
+	/**
+	 * Create a AdHoc::Lexer pattern matcher for any of a set of literal strings. The longest matching string
+	 * is matched.
+	 * @param literals The strings to match.
+	 * @return Pointer to the newly created pattern matcher.
+	 */
+	DLL_PUBLIC Lexer::PatternPtr literals(std::vector<std::string> literals);
+
+	/**
+	 * Create a AdHoc::Lexer pattern matcher for a single character of the given class.
+	 * @param chars The class of characters to match.
+	 * @return Pointer to the newly created pattern matcher.
+	 */
+	DLL_PUBLIC Lexer::PatternPtr charClass(const CharClass & chars);
+
+	/**
+	 * Create a AdHoc::Lexer pattern matcher for a run of one or more characters of the given class.
+	 * @param chars The class of characters to match.
+	 * @return Pointer to the newly created pattern matcher.
+	 */
+	DLL_PUBLIC Lexer::PatternPtr charRun(const CharClass & chars);
+
+	/**
+	 * Create a AdHoc::Lexer pattern matcher for a character of one class, followed by any number of
+	 * characters of another, e.g. identifiers.
+	 * @param first The class of the first character.
+	 * @param rest The class of subsequent characters.
+	 * @return Pointer to the newly created pattern matcher.
+	 */
+	DLL_PUBLIC Lexer::PatternPtr charRun(const CharClass & first, const CharClass & rest);
+}
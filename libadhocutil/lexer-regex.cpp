@@ -1,11 +1,15 @@
 #include "lexer-regex.h"
 #include "c++11Helpers.h"
 #include <cstddef>
+#include <cstring>
 #include <glib/gtypes.h>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Glib {
 	class ustring;
@@ -14,6 +18,7 @@ namespace AdHoc::LexerMatchers {
 	class Regex : public Lexer::Pattern {
 	public:
 		Regex(const Glib::ustring & pattern, GRegexCompileFlags compile, GRegexMatchFlags match) :
+			source(pattern), compileFlags(compile), matchFlags(match),
 			regex(g_regex_new(pattern.c_str(), compile, match, &err))
 		{
 			if (!regex) {
@@ -23,7 +28,15 @@ namespace AdHoc::LexerMatchers {
 			}
 		}
 
-		SPECIAL_MEMBERS_DELETE(Regex);
+		// Share the compiled regex, which is immutable and thread safe, but not the match state
+		explicit Regex(const Regex & other) :
+			source(other.source), compileFlags(other.compileFlags), matchFlags(other.matchFlags),
+			regex(g_regex_ref(other.regex))
+		{
+		}
+
+		Regex(Regex &&) = delete;
+		SPECIAL_MEMBERS_ASSIGN(Regex, delete);
 
 		~Regex() override
 		{
@@ -39,18 +52,25 @@ namespace AdHoc::LexerMatchers {
 		bool
 		matches(const gchar * string, size_t length, size_t position) const override
 		{
-			if (info) {
-				g_match_info_free(info);
-			}
-			g_regex_match_full(regex, string, static_cast<gssize>(length), static_cast<gint>(position),
-					G_REGEX_MATCH_ANCHORED, &info, &err);
-			if (err) {
-				auto msg = std::string("Failed to create GRegex: ") + err->message;
-				g_error_free(err);
-				throw std::runtime_error(msg);
+			return execute(string, length, position, G_REGEX_MATCH_ANCHORED);
+		}
+
+		Lexer::PatternPtr
+		instance() const override
+		{
+			return std::make_shared<Regex>(*this);
+		}
+
+		Lexer::PartialResult
+		matchesPartial(const gchar * string, size_t length, size_t position) const override
+		{
+			// A hard partial match is reported in preference to a complete one which more input could extend
+			if (!execute(string, length, position,
+						GRegexMatchFlags(G_REGEX_MATCH_ANCHORED | G_REGEX_MATCH_PARTIAL_HARD))) {
+				return g_match_info_is_partial_match(info) ? Lexer::PartialResult::NeedMore
+														   : Lexer::PartialResult::NoMatch;
 			}
-			str = string;
-			return g_match_info_matches(info);
+			return Lexer::PartialResult::Match;
 		}
 
 		size_t
@@ -61,19 +81,74 @@ namespace AdHoc::LexerMatchers {
 			return static_cast<size_t>(end - start);
 		}
 
-		std::optional<Glib::ustring>
-		match(int n) const override
+		std::optional<std::string_view>
+		matchView(int n) const override
 		{
 			gint start, end;
 			if (g_match_info_fetch_pos(info, n, &start, &end)) {
 				if (start == -1 && end == -1) {
 					return {};
 				}
-				return Glib::ustring(str + start, str + end);
+				return std::string_view(str + start, static_cast<size_t>(end - start));
 			}
 			return {};
 		}
 
+		[[nodiscard]] bool
+		matched(int n) const
+		{
+			gint start, end;
+			return g_match_info_fetch_pos(info, n, &start, &end) && start != -1;
+		}
+
+		[[nodiscard]] gint
+		captureCount() const
+		{
+			return g_regex_get_capture_count(regex);
+		}
+
+		[[nodiscard]] bool
+		combinable() const
+		{
+			// Numbered back references and subroutine calls would refer to the wrong groups once combined
+			const auto & src = source.raw();
+			for (auto c = src.begin(); c != src.end(); ++c) {
+				if (*c == '\\' && ++c != src.end()) {
+					if ((*c >= '1' && *c <= '9') || *c == 'g') {
+						return false;
+					}
+				}
+				else if (*c == '(' && std::next(c) != src.end() && *std::next(c) == '?') {
+					if (const auto n = std::next(c, 2); n != src.end() && std::strchr("0123456789+-R&P", *n)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		bool
+		execute(const gchar * string, size_t length, size_t position, GRegexMatchFlags flags) const
+		{
+			if (info) {
+				g_match_info_free(info);
+			}
+			g_regex_match_full(regex, string, static_cast<gssize>(length), static_cast<gint>(position), flags,
+					&info, &err);
+			if (err) {
+				auto msg = std::string("Failed to create GRegex: ") + err->message;
+				g_error_free(err);
+				err = nullptr;
+				throw std::runtime_error(msg);
+			}
+			str = string;
+			return g_match_info_matches(info);
+		}
+
+		const Glib::ustring source;
+		const GRegexCompileFlags compileFlags;
+		const GRegexMatchFlags matchFlags;
+
 	private:
 		mutable GError * err {nullptr};
 		GRegex * regex;
@@ -81,9 +156,159 @@ namespace AdHoc::LexerMatchers {
 		mutable const gchar * str {nullptr};
 	};
 
+	class Constituent : public Lexer::Pattern {
+	public:
+		Constituent(std::shared_ptr<const Regex> r, gint o, gint c) : combined(std::move(r)), offset(o), captures(c) { }
+
+		bool
+		matches(const gchar * string, size_t length, size_t position) const override
+		{
+			return combined->matches(string, length, position) && combined->matched(offset);
+		}
+
+		Lexer::PartialResult
+		matchesPartial(const gchar * string, size_t length, size_t position) const override
+		{
+			const auto result = combined->matchesPartial(string, length, position);
+			if (result == Lexer::PartialResult::Match && !combined->matched(offset)) {
+				return Lexer::PartialResult::NoMatch;
+			}
+			return result;
+		}
+
+		size_t
+		matchedLength() const override
+		{
+			return combined->matchedLength();
+		}
+
+		Lexer::PatternPtr
+		instance() const override
+		{
+			return std::make_shared<Constituent>(std::make_shared<const Regex>(*combined), offset, captures);
+		}
+
+		std::optional<std::string_view>
+		matchView(int n) const override
+		{
+			if (n < 0 || n > captures) {
+				return {};
+			}
+			return combined->matchView(offset + n);
+		}
+
+	private:
+		const std::shared_ptr<const Regex> combined;
+		const gint offset;
+		const gint captures;
+	};
+
+	class Combined : public Lexer::Combination {
+	public:
+		Combined(std::shared_ptr<const Regex> r, std::vector<gint> o) : combined(std::move(r)), offsets(std::move(o))
+		{
+			constituents.reserve(offsets.size());
+			for (size_t i = 0; i < offsets.size(); ++i) {
+				const auto next = (i + 1 < offsets.size()) ? offsets[i + 1] : combined->captureCount() + 1;
+				constituents.push_back(std::make_shared<Constituent>(combined, offsets[i], next - offsets[i] - 1));
+			}
+		}
+
+		std::optional<size_t>
+		select(const gchar * string, size_t length, size_t position) const override
+		{
+			if (combined->matches(string, length, position)) {
+				return matched();
+			}
+			return {};
+		}
+
+		std::pair<Lexer::PartialResult, size_t>
+		selectPartial(const gchar * string, size_t length, size_t position) const override
+		{
+			const auto result = combined->matchesPartial(string, length, position);
+			if (result == Lexer::PartialResult::Match) {
+				return {result, *matched()};
+			}
+			return {result, 0};
+		}
+
+		Lexer::PatternPtr
+		constituent(size_t i) const override
+		{
+			return constituents[i];
+		}
+
+		Lexer::CombinationPtr
+		instance() const override
+		{
+			return std::make_shared<Combined>(std::make_shared<const Regex>(*combined), offsets);
+		}
+
+	private:
+		[[nodiscard]] std::optional<size_t>
+		matched() const
+		{
+			for (size_t i = 0; i < offsets.size(); ++i) {
+				if (combined->matched(offsets[i])) {
+					return i;
+				}
+			}
+			return {};
+		}
+
+		const std::shared_ptr<const Regex> combined;
+		const std::vector<gint> offsets;
+		std::vector<Lexer::PatternPtr> constituents;
+	};
+
 	Lexer::PatternPtr
 	regex(const Glib::ustring & pattern, GRegexCompileFlags compile, GRegexMatchFlags match)
 	{
 		return std::make_shared<Regex>(pattern, compile, match);
 	}
 }
+
+namespace AdHoc::LexerMatchers {
+	std::pair<Lexer::CombinationPtr, size_t>
+	combine(std::span<const Lexer::PatternPtr> patterns)
+	{
+		std::vector<const Regex *> regexen;
+		for (const auto & p : patterns) {
+			const auto r = dynamic_cast<const Regex *>(p.get());
+			if (!r || !r->combinable()
+					|| (!regexen.empty()
+							&& (r->compileFlags != regexen.front()->compileFlags
+									|| r->matchFlags != regexen.front()->matchFlags))) {
+				break;
+			}
+			regexen.push_back(r);
+		}
+		if (regexen.size() < 2) {
+			return {nullptr, regexen.size()};
+		}
+		std::string alternation;
+		std::vector<gint> offsets;
+		gint group = 1;
+		for (const auto r : regexen) {
+			if (!alternation.empty()) {
+				alternation += '|';
+			}
+			alternation += '(';
+			alternation += r->source.raw();
+			alternation += ')';
+			offsets.push_back(group);
+			group += r->captureCount() + 1;
+		}
+		try {
+			return {std::make_shared<Combined>(std::make_shared<const Regex>(alternation, regexen.front()->compileFlags,
+												regexen.front()->matchFlags),
+							std::move(offsets)),
+					regexen.size()};
+		}
+		catch (const std::runtime_error &) {
+			// e.g. duplicate group names; fall back to matching individually
+			return {nullptr, 0};
+		}
+	}
+}
@@ -2,6 +2,8 @@
 
 #include "lexer.h" // IWYU pragma: export
 #include "visibility.h"
+#include <span>
+#include <utility>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #pragma GCC diagnostic ignored "-Wsign-conversion"
@@ -22,4 +24,13 @@ namespace AdHoc::LexerMatchers {
 	 */
 	DLL_PUBLIC Lexer::PatternPtr regex(
 			const Glib::ustring & regex, GRegexCompileFlags compile = {}, GRegexMatchFlags match = {});
+
+	/**
+	 * Combine as many of the leading patterns as possible into a single regex alternation.
+	 * Patterns must have been created by regex() with the same flags, and not use numbered back references
+	 * or subroutine calls.
+	 * @param patterns The candidate patterns, in rule order.
+	 * @return The combination (or null) and the number of leading patterns it covers.
+	 */
+	DLL_PUBLIC std::pair<Lexer::CombinationPtr, size_t> combine(std::span<const Lexer::PatternPtr> patterns);
 }
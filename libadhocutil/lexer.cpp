@@ -1,58 +1,357 @@
 #include "lexer.h"
 #include "compileTimeFormatter.h"
+#include "lexer-regex.h"
+#include <algorithm>
+#include <future>
+#include <map>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <utility>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#ifndef __clang__
+#	pragma GCC diagnostic ignored "-Wuseless-cast"
+#endif
+#include <glibmm/ustring.h>
+#pragma GCC diagnostic pop
 
 namespace AdHoc {
 	const Lexer::State Lexer::InitialState = "";
 
+	/// Interned states and their candidate rules, in order, optionally with combinable patterns merged.
+	class Lexer::Compiled {
+	public:
+		/// A single rule, or a run of rules selected by a combination.
+		struct Candidate {
+			PatternPtr pattern;
+			CombinationPtr combination;
+			std::vector<Handler> handlers;
+		};
+		using Candidates = std::vector<Candidate>;
+
+		Compiled(const Rules & rules, bool combine)
+		{
+			intern(InitialState);
+			for (const auto & r : rules) {
+				for (const auto & s : std::get<0>(r)) {
+					intern(s);
+				}
+			}
+			for (StateId id = 0; id < names.size(); ++id) {
+				std::vector<PatternPtr> patterns;
+				std::vector<Handler> handlers;
+				for (const auto & r : rules) {
+					if (std::get<0>(r).contains(names[id])) {
+						patterns.push_back(std::get<1>(r));
+						handlers.push_back(std::get<2>(r));
+					}
+				}
+				auto & candidates = states[id];
+				for (size_t i = 0; i < patterns.size();) {
+					std::pair<CombinationPtr, size_t> combined;
+					if (combine) {
+						combined = LexerMatchers::combine(std::span(patterns).subspan(i));
+					}
+					auto & [combination, n] = combined;
+					if (combination && n > 1) {
+						candidates.push_back({nullptr, std::move(combination),
+								{handlers.begin() + static_cast<ptrdiff_t>(i),
+										handlers.begin() + static_cast<ptrdiff_t>(i + n)}});
+						i += n;
+					}
+					else {
+						candidates.push_back({patterns[i], nullptr, {handlers[i]}});
+						i += 1;
+					}
+				}
+			}
+		}
+
+		[[nodiscard]] std::optional<StateId>
+		find(const State & s) const
+		{
+			if (const auto i = ids.find(s); i != ids.end()) {
+				return i->second;
+			}
+			return {};
+		}
+
+		std::vector<State> names;
+		std::vector<Candidates> states;
+
+	private:
+		void
+		intern(const State & s)
+		{
+			if (ids.emplace(s, static_cast<StateId>(names.size())).second) {
+				names.push_back(s);
+				states.emplace_back();
+			}
+		}
+
+		std::map<State, StateId> ids;
+	};
+
 	Lexer::Lexer() = default;
 
 	Lexer::Lexer(Rules r) : rules(std::move(r)) { }
 
+	void
+	Lexer::compile()
+	{
+		compiled = std::make_shared<const Compiled>(rules, true);
+	}
+
+	Lexer::PartialResult
+	Lexer::Pattern::matchesPartial(const gchar * string, size_t length, size_t position) const
+	{
+		if (matches(string, length, position) && position + matchedLength() < length) {
+			return PartialResult::Match;
+		}
+		return PartialResult::NeedMore;
+	}
+
+	std::optional<std::string_view>
+	Lexer::Pattern::matchView(int n) const
+	{
+		if (const auto m = match(n)) {
+			auto & copy = copies[n];
+			copy = m->raw();
+			return copy;
+		}
+		return {};
+	}
+
+	std::optional<Glib::ustring>
+	Lexer::Pattern::match(int n) const
+	{
+		if (const auto m = matchView(n)) {
+			return Glib::ustring(m->data(), m->data() + m->length());
+		}
+		return {};
+	}
+
+	Lexer::PatternPtr
+	Lexer::Pattern::instance() const
+	{
+		return nullptr;
+	}
+
 	AdHocFormatter(UnexpectedInputState, "Unexpected input in state (%?) at %?");
+	const Lexer::Handler *
+	Lexer::select(const Compiled & program, ExecuteState & es, const gchar * string, size_t length, bool more)
+	{
+		if (const auto state = es.stateStack.back(); state < program.states.size()) {
+			const auto & candidates = program.states[state];
+			const auto instances = es.instantiate ? &es.candidates(state) : nullptr;
+			for (size_t c = 0; c < candidates.size(); ++c) {
+				const auto & handlers = candidates[c].handlers;
+				const auto & pattern = instances ? (*instances)[c].pattern : candidates[c].pattern;
+				const auto & combination = instances ? (*instances)[c].combination : candidates[c].combination;
+				if (combination) {
+					if (more) {
+						const auto [result, i] = combination->selectPartial(string, length, es.pos);
+						if (result == PartialResult::NeedMore) {
+							return nullptr;
+						}
+						if (result == PartialResult::Match) {
+							es.pat = combination->constituent(i);
+							return &handlers[i];
+						}
+					}
+					else if (const auto i = combination->select(string, length, es.pos)) {
+						es.pat = combination->constituent(*i);
+						return &handlers[*i];
+					}
+				}
+				else if (more) {
+					const auto result = pattern->matchesPartial(string, length, es.pos);
+					if (result == PartialResult::NeedMore) {
+						return nullptr;
+					}
+					if (result == PartialResult::Match) {
+						es.pat = pattern;
+						return &handlers.front();
+					}
+				}
+				else if (pattern->matches(string, length, es.pos)) {
+					es.pat = pattern;
+					return &handlers.front();
+				}
+			}
+		}
+		throw std::runtime_error(UnexpectedInputState::get(es.getState(), string + es.pos));
+	}
+
 	void
 	Lexer::extract(const gchar * string, size_t length) const
 	{
-		ExecuteState es;
+		std::optional<const Compiled> tabulated;
+		const auto & program = compiled ? *compiled : tabulated.emplace(rules, false);
+		// Match with the rules' own patterns, as handlers may read captures from them
+		ExecuteState es {&program, false};
 		while (es.pos < length) {
-			const Rule * selected = nullptr;
-			for (const auto & r : rules) {
-				const auto & s = std::get<0>(r);
-				if (s.find(es.getState()) == s.end()) {
-					continue;
+			const auto selected = select(program, es, string, length, false);
+			(*selected)(&es);
+			es.pos += es.pat->matchedLength();
+		}
+	}
+
+	void
+	Lexer::extractParallel(const gchar * string, size_t length, std::string_view delimiter, unsigned int pieces) const
+	{
+		const auto program = compiled ? compiled : std::make_shared<const Compiled>(rules, false);
+		const std::string_view input {string, length};
+		pieces = std::max(pieces, 1U);
+		std::vector<std::future<void>> extractions;
+		for (size_t begin = 0, piece = 1; begin < length; ++piece) {
+			auto end = length;
+			if (piece < pieces && !delimiter.empty()) {
+				if (const auto d = input.find(delimiter, std::max(begin, length / pieces * piece));
+						d != std::string_view::npos) {
+					end = d + delimiter.length();
 				}
-				const auto & p = std::get<1>(r);
-				if (p->matches(string, length, es.pos)) {
-					selected = &r;
-					break;
+			}
+			extractions.push_back(std::async(std::launch::async, [&program, string, begin, end]() {
+				ExecuteState es {program.get(), true};
+				es.base = begin;
+				while (es.pos < end - begin) {
+					const auto selected = select(*program, es, string + begin, end - begin, false);
+					(*selected)(&es);
+					es.pos += es.pat->matchedLength();
+				}
+			}));
+			begin = end;
+		}
+		for (auto & extraction : extractions) {
+			extraction.get();
+		}
+	}
+
+	Lexer::Stream::Stream(const Lexer & lexer, size_t lb, size_t mt) :
+		program(lexer.compiled ? lexer.compiled : std::make_shared<const Compiled>(lexer.rules, false)),
+		es(program.get(), true), lookback(std::max<size_t>(lb, 1)), maxToken(mt)
+	{
+	}
+
+	void
+	Lexer::Stream::feed(const gchar * chunk, size_t length)
+	{
+		buffer.append(chunk, length);
+		run(false);
+	}
+
+	void
+	Lexer::Stream::finish()
+	{
+		run(true);
+	}
+
+	const Lexer::ExecuteState &
+	Lexer::Stream::state() const
+	{
+		return es;
+	}
+
+	namespace {
+		// Length of the input excluding any incomplete UTF-8 sequence at the end
+		size_t
+		completeLength(const std::string & buffer)
+		{
+			for (size_t back = 1; back <= 4 && back <= buffer.length(); ++back) {
+				const auto c = static_cast<unsigned char>(buffer[buffer.length() - back]);
+				if ((c & 0xC0U) != 0x80U) {
+					const size_t sequence = (c >= 0xF0U) ? 4 : (c >= 0xE0U) ? 3 : (c >= 0xC0U) ? 2 : 1;
+					return (sequence > back) ? buffer.length() - back : buffer.length();
 				}
 			}
+			return buffer.length();
+		}
+	}
+
+	void
+	Lexer::Stream::run(bool final)
+	{
+		const auto length = final ? buffer.length() : completeLength(buffer);
+		while (es.pos < length) {
+			const auto selected = select(*program, es, buffer.data(), length, !final);
 			if (!selected) {
-				throw std::runtime_error(UnexpectedInputState::get(es.getState(), string + es.pos));
+				break;
 			}
-			es.pat = std::get<1>(*selected);
-			const auto & h = std::get<2>(*selected);
-			h(&es);
+			(*selected)(&es);
 			es.pos += es.pat->matchedLength();
 		}
+		es.pat.reset();
+		if (es.pos > lookback) {
+			const auto discard = es.pos - lookback;
+			buffer.erase(0, discard);
+			es.pos -= discard;
+			es.base += discard;
+		}
+		if (buffer.length() - es.pos > maxToken) {
+			throw std::length_error("Lexer stream pending input exceeds maximum token length");
+		}
+	}
+
+	Lexer::ExecuteState::ExecuteState() : ExecuteState(nullptr, false) { }
+
+	Lexer::ExecuteState::ExecuteState(const Compiled * p, bool i) : instantiate(i), program(p)
+	{
+		stateStack.push_back(intern(InitialState));
+	}
+
+	const std::vector<Lexer::ExecuteState::Candidate> &
+	Lexer::ExecuteState::candidates(StateId state)
+	{
+		if (instances.size() <= state) {
+			instances.resize(program->states.size());
+		}
+		auto & candidates = instances[state];
+		if (candidates.empty()) {
+			for (const auto & c : program->states[state]) {
+				if (c.combination) {
+					candidates.push_back({nullptr, c.combination->instance()});
+				}
+				else {
+					auto pattern = c.pattern->instance();
+					candidates.push_back({pattern ? std::move(pattern) : c.pattern, nullptr});
+				}
+			}
+		}
+		return candidates;
 	}
 
-	Lexer::ExecuteState::ExecuteState()
+	Lexer::StateId
+	Lexer::ExecuteState::intern(const State & s)
 	{
-		stateStack.push_back(InitialState);
+		const StateId known = program ? static_cast<StateId>(program->names.size()) : 0;
+		if (program) {
+			if (const auto id = program->find(s)) {
+				return *id;
+			}
+		}
+		// States not referenced by any rule can still be entered, though no input can be matched in them
+		for (StateId id = 0; id < unknownStates.size(); ++id) {
+			if (unknownStates[id] == s) {
+				return known + id;
+			}
+		}
+		unknownStates.push_back(s);
+		return known + static_cast<StateId>(unknownStates.size() - 1);
 	}
 
 	void
 	Lexer::ExecuteState::setState(const State & s)
 	{
-		stateStack.back() = s;
+		stateStack.back() = intern(s);
 	}
 
 	void
 	Lexer::ExecuteState::pushState(const State & s)
 	{
-		stateStack.push_back(s);
+		stateStack.push_back(intern(s));
 	}
 
 	void
@@ -64,7 +363,11 @@ namespace AdHoc {
 	const Lexer::State &
 	Lexer::ExecuteState::getState() const
 	{
-		return stateStack.back();
+		const StateId known = program ? static_cast<StateId>(program->names.size()) : 0;
+		if (stateStack.back() < known) {
+			return program->names[stateStack.back()];
+		}
+		return unknownStates[stateStack.back() - known];
 	}
 
 	size_t
@@ -76,7 +379,7 @@ namespace AdHoc {
 	size_t
 	Lexer::ExecuteState::position() const
 	{
-		return pos;
+		return base + pos;
 	}
 
 	Lexer::PatternPtr
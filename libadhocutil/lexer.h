@@ -4,6 +4,7 @@
 #include "visibility.h"
 #include <cstddef>
 #include <functional>
+#include <map>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #ifndef __clang__
@@ -15,7 +16,10 @@
 #include <optional>
 #include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace Glib {
@@ -26,6 +30,9 @@ namespace AdHoc {
 	/// An extensible lexer.
 	class DLL_PUBLIC Lexer {
 	public:
+		/// Result of testing a pattern against input which may yet be extended (see Stream).
+		enum class PartialResult { NoMatch, Match, NeedMore };
+
 		/// Pattern matcher interface.
 		class Pattern {
 		public:
@@ -38,16 +45,66 @@ namespace AdHoc {
 			[[nodiscard]] virtual bool matches(const gchar *, size_t, size_t) const = 0;
 			/// Get the total amount of input matched.
 			[[nodiscard]] virtual size_t matchedLength() const = 0;
-			/// Get an extracted value from the pattern.
-			[[nodiscard]] virtual std::optional<Glib::ustring> match(int) const = 0;
+			/**
+			 * Get an extracted value from the pattern, as a view of the input (valid until the input changes).
+			 * Implementations must override at least one of this and match(). The default implementation
+			 * returns a view of a copy from match(), valid until the same value is next requested.
+			 */
+			[[nodiscard]] virtual std::optional<std::string_view> matchView(int) const;
+			/// Get an extracted value from the pattern. The default implementation copies matchView().
+			[[nodiscard]] virtual std::optional<Glib::ustring> match(int) const;
+			/**
+			 * Test the pattern against input which may yet be extended.
+			 * The default implementation only considers a match ending before the end of the input to be
+			 * conclusive. It can't tell whether a failure is conclusive, so never reports NoMatch: a Stream then
+			 * holds back all input from wherever the pattern fails, in a state where it's a candidate, until
+			 * finish() (or maxToken). Patterns used with a Stream must override this to report conclusive
+			 * non-matches.
+			 */
+			[[nodiscard]] virtual PartialResult matchesPartial(const gchar *, size_t, size_t) const;
+			/**
+			 * Create a pattern sharing this one's definition, but with its own match state, for use by a single
+			 * execution of the lexer (by Stream or extractParallel()). Implementations should override this to
+			 * allow concurrent extraction; the default returns null, meaning this pattern is shared.
+			 */
+			[[nodiscard]] virtual std::shared_ptr<Pattern> instance() const;
+
+		private:
+			mutable std::map<int, std::string> copies;
 		};
 		/// Smart pointer to Pattern.
 		using PatternPtr = std::shared_ptr<Pattern>;
+		/// Matcher selecting the first of several patterns to match with a single test (see compile()).
+		class Combination {
+		public:
+			Combination() = default;
+			virtual ~Combination() = default;
+			/// Standard move/copy support
+			SPECIAL_MEMBERS_DEFAULT(Combination);
+
+			/// Test the given input, returning the index of the first constituent pattern to match.
+			[[nodiscard]] virtual std::optional<size_t> select(const gchar *, size_t, size_t) const = 0;
+			/// As select(), but for input which may yet be extended.
+			[[nodiscard]] virtual std::pair<PartialResult, size_t> selectPartial(
+					const gchar *, size_t, size_t) const = 0;
+			/// Get a pattern presenting the most recent match of the given constituent.
+			[[nodiscard]] virtual PatternPtr constituent(size_t) const = 0;
+			/// Create a combination sharing this one's definition, but with its own match state.
+			[[nodiscard]] virtual std::shared_ptr<Combination> instance() const = 0;
+		};
+		/// Smart pointer to Combination.
+		using CombinationPtr = std::shared_ptr<Combination>;
 		/// Lexer state identifiers.
 		using State = std::string;
 		/// Collection of States.
 		using States = std::set<State>;
+		/// Interned state identifier, as used internally during execution.
+		using StateId = unsigned int;
+
+	private:
+		class Compiled;
 
+	public:
 		/// Class representing the runtime execution of the lexer.
 		class ExecuteState {
 		public:
@@ -64,17 +121,33 @@ namespace AdHoc {
 			[[nodiscard]] const State & getState() const;
 			/// Get the state stack depth.
 			[[nodiscard]] size_t depth() const;
-			/// Get the current position.
+			/// Get the current position (from the start of all input, when streaming).
 			[[nodiscard]] size_t position() const;
 			/// Get the currently matched pattern.
 			[[nodiscard]] PatternPtr pattern() const;
 
 		private:
 			friend class Lexer;
+			ExecuteState(const Compiled *, bool instantiate);
+			[[nodiscard]] StateId intern(const State &);
+
 			size_t pos {0};
+			size_t base {0};
 			PatternPtr pat;
+			/// Match with instances of the rules' patterns, rather than the patterns themselves.
+			bool instantiate;
 
-			std::vector<State> stateStack;
+			/// Per execution instance of a candidate rule's matcher.
+			struct Candidate {
+				PatternPtr pattern;
+				CombinationPtr combination;
+			};
+			[[nodiscard]] const std::vector<Candidate> & candidates(StateId);
+
+			const Compiled * program;
+			std::vector<State> unknownStates;
+			std::vector<StateId> stateStack;
+			std::vector<std::vector<Candidate>> instances;
 		};
 
 		/// Callback for handling matched patterns.
@@ -97,7 +170,83 @@ namespace AdHoc {
 		/// The lexer's current rule set.
 		Rules rules;
 
-		/// Execute the lexer to extract matches for the current rules.
+		/**
+		 * Compile the current rules for faster extraction.
+		 * States are interned and the rules applicable to each are tabulated. Consecutive rules applicable to a
+		 * state whose patterns can be combined (such as regexen with the same flags) are merged, such that a
+		 * single test of the input selects the rule; the handlers of such rules must then read captures through
+		 * ExecuteState::pattern(), rather than the rules' own patterns.
+		 * Must be called again after changing rules; without it, extract() tabulates the rules on each call.
+		 */
+		void compile();
+
+		/**
+		 * Execute the lexer to extract matches for the current rules.
+		 * The rules' own patterns are matched (unless combined by compile()), so handlers may read captures
+		 * from them; hence extract() must not be called concurrently with other uses of the same patterns.
+		 */
 		void extract(const gchar * string, size_t length) const;
+
+		/**
+		 * Execute the lexer over large input in parallel.
+		 * The input is split, after occurrences of the delimiter, into roughly equal pieces, each of which is
+		 * extracted concurrently from the initial state, by instances (see Pattern::instance()) of the rules'
+		 * patterns. Handlers must be thread safe, and read captures through ExecuteState::pattern(); positions
+		 * are relative to the whole input. The lexer should be compiled first.
+		 * @param string The input.
+		 * @param length The length of the input.
+		 * @param delimiter The record delimiter, after which lexing may safely restart.
+		 * @param pieces The maximum number of pieces to extract concurrently.
+		 */
+		void extractParallel(const gchar * string, size_t length, std::string_view delimiter,
+				unsigned int pieces = std::thread::hardware_concurrency()) const;
+
+		/**
+		 * Incremental execution of the lexer over input supplied in chunks.
+		 * Handlers are called as soon as each token is conclusively matched; consumed input is discarded,
+		 * save a lookback window available to patterns such as regex lookbehind assertions. Like
+		 * extractParallel(), a stream matches with its own instances of the rules' patterns, so several may run
+		 * concurrently.
+		 * Incomplete UTF-8 sequences at the end of a chunk are held back until the next. Tokens are only
+		 * extracted early if the rules' patterns implement Pattern::matchesPartial().
+		 */
+		class DLL_PUBLIC Stream {
+		public:
+			/// Default amount of consumed input to retain.
+			static constexpr size_t DEFAULT_LOOKBACK = 64;
+			/// Default limit on the size of a single token.
+			static constexpr size_t DEFAULT_MAX_TOKEN = 1U << 20U;
+
+			/**
+			 * Create a stream for the given lexer's current (compiled) rules.
+			 * @param lexer The lexer, which must outlive the stream.
+			 * @param lookback The amount of consumed input to retain (at least 1).
+			 * @param maxToken The maximum amount of pending input; exceeding it throws std::length_error.
+			 */
+			explicit Stream(
+					const Lexer & lexer, size_t lookback = DEFAULT_LOOKBACK, size_t maxToken = DEFAULT_MAX_TOKEN);
+
+			/// Supply the next chunk of input.
+			void feed(const gchar * chunk, size_t length);
+			/// Signal the end of input, extracting any remaining tokens.
+			void finish();
+			/// Get the execution state, e.g. to check the final lexer state.
+			[[nodiscard]] const ExecuteState & state() const;
+
+		private:
+			DLL_PRIVATE void run(bool final);
+
+			std::shared_ptr<const Compiled> program;
+			ExecuteState es;
+			std::string buffer;
+			const size_t lookback;
+			const size_t maxToken;
+		};
+
+	private:
+		DLL_PRIVATE static const Handler * select(
+				const Compiled &, ExecuteState &, const gchar * string, size_t length, bool more);
+
+		std::shared_ptr<const Compiled> compiled;
 	};
 }
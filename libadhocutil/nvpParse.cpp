@@ -0,0 +1,111 @@
+#include "nvpParse.h"
+
+namespace AdHoc {
+	NvpParse::ValueNotFound::ValueNotFound(const std::string & vn) : std::runtime_error("Value not found: " + vn) { }
+
+	namespace {
+		constexpr bool
+		isSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+		}
+
+		constexpr bool
+		isAlpha(char c)
+		{
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+		}
+
+		constexpr bool
+		isElement(char c)
+		{
+			return isAlpha(c) || (c >= '0' && c <= '9') || c == '_' || c == '-';
+		}
+
+		[[noreturn]] void
+		lexError(std::string_view in, size_t p)
+		{
+			throw std::runtime_error(std::string("Lex error at: ").append(in.substr(p, 1)));
+		}
+
+		// Length of the identifier at p: element ("." element)*, element being [a-zA-Z][a-zA-Z0-9_-]*
+		size_t
+		identifier(std::string_view in, size_t p)
+		{
+			auto e = p;
+			while (e < in.length() && isAlpha(in[e])) {
+				e += 1;
+				while (e < in.length() && isElement(in[e])) {
+					e += 1;
+				}
+				if (e + 1 < in.length() && in[e] == '.' && isAlpha(in[e + 1])) {
+					e += 1;
+				}
+			}
+			return e - p;
+		}
+	}
+
+	void
+	NvpParse::parse(std::string_view in, const Assign & assign)
+	{
+		enum class Expect { Name, Equal, Value, Semi } expect {Expect::Name};
+		std::string_view name;
+		for (size_t p = 0; p < in.length();) {
+			const auto c = in[p];
+			if (expect == Expect::Value ? c == ' ' : isSpace(c)) {
+				p += 1;
+				continue;
+			}
+			switch (expect) {
+				case Expect::Name:
+					if (!isAlpha(c)) {
+						lexError(in, p);
+					}
+					name = in.substr(p, identifier(in, p));
+					p += name.length();
+					expect = Expect::Equal;
+					break;
+				case Expect::Equal:
+					if (c != '=') {
+						lexError(in, p);
+					}
+					p += 1;
+					expect = Expect::Value;
+					break;
+				case Expect::Value: {
+					// Any other character (even ;) begins a value, which runs to the next ;
+					const auto end = std::min(in.find(';', p + 1), in.length());
+					assign(name, in.substr(p, end - p));
+					p = end;
+					expect = Expect::Semi;
+					break;
+				}
+				case Expect::Semi:
+					if (c != ';') {
+						lexError(in, p);
+					}
+					p += 1;
+					expect = Expect::Name;
+					break;
+			}
+		}
+	}
+
+	std::vector<std::string_view>
+	NvpParse::splitLines(std::string_view in, unsigned int pieces)
+	{
+		std::vector<std::string_view> out;
+		const auto target = in.length() / std::max(pieces, 1U);
+		while (!in.empty()) {
+			auto end = in.length();
+			if (out.size() + 1 < pieces) {
+				end = std::min(in.find('\n', target), in.length());
+				end = std::min(end + 1, in.length());
+			}
+			out.push_back(in.substr(0, end));
+			in.remove_prefix(end);
+		}
+		return out;
+	}
+}
@@ -1,16 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
+#include <charconv>
 #include <functional>
+#include <future>
 #include <istream>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
-#ifndef yyFlexLexer
-#	define yyFlexLexer nvpBaseFlexLexer
-#	include <FlexLexer.h>
-#endif
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 #include "c++11Helpers.h"
+#include "fileUtils.h"
 #include "visibility.h"
 
 namespace AdHoc {
@@ -20,23 +28,20 @@ namespace AdHoc {
 	 * Parses an input stream of the format Name=Value;Name2=Value2;... into a predefined object
 	 * structure.
 	 */
-	class NvpParse : public yyFlexLexer {
+	class NvpParse {
 	public:
 		/// @cond
 		/// Thrown in the event of the input referring to a member that doesn't exist.
-		class ValueNotFound : public std::runtime_error {
+		class DLL_PUBLIC ValueNotFound : public std::runtime_error {
 		public:
 			explicit ValueNotFound(const std::string &);
 		};
 
-		using AssignFunc = std::function<void(const std::string &)>;
-		using AssignMap = std::map<std::string, AssignFunc>;
-
 		template<typename T> class TargetBase {
 		public:
 			TargetBase() = default;
 			virtual ~TargetBase() = default;
-			virtual AssignFunc assign(T *) const = 0;
+			virtual void assign(T &, std::string_view) const = 0;
 			SPECIAL_MEMBERS_DEFAULT(TargetBase);
 		};
 
@@ -44,12 +49,10 @@ namespace AdHoc {
 		public:
 			explicit Target(V T::*t) : target(t) { }
 
-			AssignFunc
-			assign(T * t) const override
+			void
+			assign(T & t, std::string_view value) const override
 			{
-				return [t, this](const std::string & value) {
-					t->*target = boost::lexical_cast<V>(value);
-				};
+				convert(value, t.*target);
 			}
 
 		private:
@@ -63,6 +66,61 @@ namespace AdHoc {
 #		m, std::make_shared < ::AdHoc::NvpParse::Target < c, decltype(c::m)>>(&c::m) \
 	}
 
+		/// Name lookup table for a target type, built once from its Target Map and reusable across parses.
+		template<typename T> class Table {
+		public:
+			/// Build the table from a Target Map.
+			explicit Table(const NvpTarget(T) & tm) : entries(tm.begin(), tm.end()) { }
+
+			/// Find the target for the given name, throwing ValueNotFound if there isn't one.
+			[[nodiscard]] const TargetBase<T> &
+			find(std::string_view name) const
+			{
+				// Entries are in map order, i.e. sorted by name
+				const auto e = std::lower_bound(entries.begin(), entries.end(), name, [](const auto & entry, auto n) {
+					return entry.first < n;
+				});
+				if (e == entries.end() || e->first != name) {
+					throw ValueNotFound(std::string(name));
+				}
+				return *e->second;
+			}
+
+		private:
+			std::vector<std::pair<std::string, std::shared_ptr<const TargetBase<T>>>> entries;
+		};
+
+		/// Callback for each name/value pair found in the input.
+		using Assign = std::function<void(std::string_view name, std::string_view value)>;
+
+		/** Parse input into the given object.
+		 * @param in The input.
+		 * @param table The lookup table for the object.
+		 * @param t The target instance to populate.
+		 */
+		template<typename T>
+		static void
+		parse(std::string_view in, const Table<T> & table, T & t)
+		{
+			parse(in, [&table, &t](std::string_view name, std::string_view value) {
+				table.find(name).assign(t, value);
+			});
+		}
+
+		/** Parse an input stream into the given object.
+		 * @param in The input stream.
+		 * @param table The lookup table for the object.
+		 * @param t The target instance to populate.
+		 */
+		template<typename T>
+		static void
+		parse(std::istream & in, const Table<T> & table, T & t)
+		{
+			std::ostringstream buf;
+			buf << in.rdbuf();
+			parse(buf.view(), table, t);
+		}
+
 		/** Parse an input stream into the given object.
 		 * @param in The input stream.
 		 * @param tm The Target Map for the object.
@@ -72,27 +130,168 @@ namespace AdHoc {
 		static void
 		parse(std::istream & in, const NvpTarget(T) & tm, T & t)
 		{
-			NvpParse::AssignMap am;
-			for (const auto & v : tm) {
-				am[v.first] = v.second->assign(&t);
+			parse(in, Table<T> {tm}, t);
+		}
+
+		/** Parse records, one per line, appending an object to the output for each. Blank lines are skipped.
+		 * If a record fails to parse, those before it have been appended, but it has not.
+		 * @param in The input.
+		 * @param table The lookup table for the objects.
+		 * @param out The vector to append to.
+		 */
+		template<typename T>
+		static void
+		parseRecords(std::string_view in, const Table<T> & table, std::vector<T> & out)
+		{
+			out.reserve(out.size() + static_cast<size_t>(std::count(in.begin(), in.end(), '\n')) + 1);
+			forEachLine(in, [&table, &out](std::string_view line) {
+				out.push_back(parseRecord(line, table));
+			});
+		}
+
+		/** Parse records, one per line, into objects, optionally splitting the input across threads.
+		 * @param in The input.
+		 * @param table The lookup table for the objects.
+		 * @param threads The number of threads to use; the input is split between them on line boundaries.
+		 * @return The objects, in input order.
+		 */
+		template<typename T>
+		static std::vector<T>
+		parseRecords(std::string_view in, const Table<T> & table, unsigned int threads = 1)
+		{
+			std::vector<T> out;
+			const auto pieces = splitLines(in, threads);
+			if (pieces.size() <= 1) {
+				parseRecords(in, table, out);
+				return out;
+			}
+			std::vector<std::future<std::vector<T>>> parts;
+			parts.reserve(pieces.size());
+			for (const auto piece : pieces) {
+				parts.push_back(std::async(std::launch::async, [piece, &table]() {
+					std::vector<T> part;
+					parseRecords(piece, table, part);
+					return part;
+				}));
+			}
+			for (auto & part : parts) {
+				auto objects = part.get();
+				if (out.empty()) {
+					out = std::move(objects);
+				}
+				else {
+					out.insert(out.end(), std::make_move_iterator(objects.begin()),
+							std::make_move_iterator(objects.end()));
+				}
+			}
+			return out;
+		}
+
+		/** Parse records, one per line, from a memory mapped file.
+		 * @param in The mapped file.
+		 * @param table The lookup table for the objects.
+		 * @param threads The number of threads to use; the input is split between them on line boundaries.
+		 * @return The objects, in input order.
+		 */
+		template<typename T>
+		static std::vector<T>
+		parseRecords(const FileUtils::MemMap & in, const Table<T> & table, unsigned int threads = 1)
+		{
+			return parseRecords(in.sv(), table, threads);
+		}
+
+		/** Parse records, one per line, from a stream, appending an object to the output for each.
+		 * If a record fails to parse, those before it have been appended, but it has not.
+		 * @param in The input stream.
+		 * @param table The lookup table for the objects.
+		 * @param out The vector to append to.
+		 */
+		template<typename T>
+		static void
+		parseRecords(std::istream & in, const Table<T> & table, std::vector<T> & out)
+		{
+			for (std::string line; std::getline(in, line);) {
+				forEachLine(line, [&table, &out](std::string_view l) {
+					out.push_back(parseRecord(l, table));
+				});
 			}
-			return parse(in, am);
 		}
 
-		/** Don't use this function directly, instead use:
-		 * @code {.cpp} void parse(std::istream & in, const NvpTarget(T) & tm, T & t) @endcode
+		/** Split input into (up to) the given number of pieces of similar size, on line boundaries.
+		 * @param in The input.
+		 * @param pieces The number of pieces.
+		 * @return The pieces.
+		 */
+		DLL_PUBLIC static std::vector<std::string_view> splitLines(std::string_view in, unsigned int pieces);
+
+		/** Parse input, calling assign for each name/value pair found.
+		 * @param in The input.
+		 * @param assign The callback.
 		 */
-		DLL_PUBLIC static void parse(std::istream & in, const AssignMap & m);
+		DLL_PUBLIC static void parse(std::string_view in, const Assign & assign);
+
+		/// Convert a value, as for assignment to a target member.
+		template<typename V>
+		static void
+		convert(std::string_view value, V & v)
+		{
+			if constexpr (std::is_assignable_v<V &, std::string_view>) {
+				v = value;
+			}
+			else if constexpr ((std::is_integral_v<V> && !std::is_same_v<V, bool> && !isCharacter<V>)
+					|| std::is_floating_point_v<V>) {
+				if constexpr (std::is_unsigned_v<V>) {
+					if (value.starts_with('-')) {
+						// Negative values wrap around, as lexical_cast has it
+						v = boost::lexical_cast<V>(value);
+						return;
+					}
+				}
+				if (value.starts_with('+') && !value.starts_with("+-")) {
+					value.remove_prefix(1);
+				}
+				const auto end = value.data() + value.length();
+				if (const auto r = std::from_chars(value.data(), end, v); r.ec != std::errc {} || r.ptr != end) {
+					throw boost::bad_lexical_cast(typeid(std::string_view), typeid(V));
+				}
+			}
+			else {
+				// Including character types, which take a single character rather than a number
+				v = boost::lexical_cast<V>(value);
+			}
+		}
 
 	private:
-		NvpParse(std::istream & in, const AssignMap &);
+		template<typename V>
+		static constexpr bool isCharacter = std::is_same_v<V, char> || std::is_same_v<V, signed char>
+				|| std::is_same_v<V, unsigned char> || std::is_same_v<V, wchar_t> || std::is_same_v<V, char8_t>
+				|| std::is_same_v<V, char16_t> || std::is_same_v<V, char32_t>;
 
-		int yylex() override;
-		void LexerError(const char * msg) override;
+		template<typename T>
+		static T
+		parseRecord(std::string_view line, const Table<T> & table)
+		{
+			T t {};
+			parse(line, table, t);
+			return t;
+		}
 
-		void process(const std::string & value) const;
-		std::string name;
-		const AssignMap values;
+		template<typename F>
+		static void
+		forEachLine(std::string_view in, const F & f)
+		{
+			while (!in.empty()) {
+				const auto eol = std::min(in.find('\n'), in.length());
+				auto line = in.substr(0, eol);
+				in.remove_prefix(std::min(eol + 1, in.length()));
+				if (line.ends_with('\r')) {
+					line.remove_suffix(1);
+				}
+				if (line.find_first_not_of(" \t\f") != std::string_view::npos) {
+					f(line);
+				}
+			}
+		}
 	};
 
 }
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Report compile time and object size of perfCompileTimeFormatterBuild.cpp
+# for a range of formatter counts.
+# Usage: ctfBuildCost.sh [counts...] (default 16 64 256)
+# Honours CXX and CXXFLAGS (default -O2).
+set -e
+cd "$(dirname "$0")"
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+echo "formatters	seconds	text-bytes"
+for n in ${@:-16 64 256}; do
+	start=$(date +%s.%N)
+	$CXX -std=c++20 $CXXFLAGS -I.. -DFORMATTERS="$n" -c perfCompileTimeFormatterBuild.cpp -o "$OUT/ctf$n.o"
+	end=$(date +%s.%N)
+	text=$(size "$OUT/ctf$n.o" | awk 'NR == 2 { print $1 }')
+	echo "$n	$(awk "BEGIN { print $end - $start }")	$text"
+done
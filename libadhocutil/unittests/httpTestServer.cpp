@@ -0,0 +1,411 @@
+#include "httpTestServer.h"
+#include <algorithm>
+#include <array>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+	int
+	check(int rc, const char * what)
+	{
+		if (rc < 0) {
+			throw std::runtime_error(std::string(what) + ": " + strerror(errno));
+		}
+		return rc;
+	}
+
+	void
+	watch(int epoll, int op, int fd, uint32_t events)
+	{
+		epoll_event e {};
+		e.events = events;
+		e.data.fd = fd;
+		check(epoll_ctl(epoll, op, fd, &e), "epoll_ctl(2)");
+	}
+
+	/// Take one from count, if it isn't already zero.
+	bool
+	take(std::atomic<size_t> & count)
+	{
+		auto c = count.load();
+		while (c && !count.compare_exchange_weak(c, c - 1)) { }
+		return c;
+	}
+}
+
+HttpTestServer::HttpTestServer(size_t bodySize) : HttpTestServer {bodySize, Options {}} { }
+
+HttpTestServer::HttpTestServer(size_t bodySize, const Options & o) : HttpTestServer {std::string(bodySize, 'x'), {}, o}
+{
+}
+
+HttpTestServer::HttpTestServer(std::string_view body, std::string_view contentEncoding) :
+	HttpTestServer {body, contentEncoding, Options {}}
+{
+}
+
+HttpTestServer::HttpTestServer(std::string_view body, std::string_view contentEncoding, const Options & o) :
+	listener {check(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket(2)")},
+	epoll {check(epoll_create1(EPOLL_CLOEXEC), "epoll_create1(2)")},
+	wake {check(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd(2)")},
+	response {"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"}, options {o},
+	erroring {std::clamp(o.errorRate, 0.0, 1.0)}
+{
+	if (!contentEncoding.empty()) {
+		response.append("Content-Encoding: ").append(contentEncoding).append("\r\n");
+	}
+	if (options.chunkSize) {
+		response.append("Transfer-Encoding: chunked\r\n\r\n");
+		for (auto remaining = body; !remaining.empty();) {
+			const auto chunk = remaining.substr(0, options.chunkSize);
+			remaining.remove_prefix(chunk.length());
+			std::array<char, 16> size {};
+			response.append(size.data(), std::to_chars(size.begin(), size.end(), chunk.length(), 16).ptr)
+					.append("\r\n")
+					.append(chunk)
+					.append("\r\n");
+		}
+		response.append("0\r\n\r\n");
+	}
+	else {
+		response.append("Content-Length: ").append(std::to_string(body.length())).append("\r\n\r\n").append(body);
+	}
+	const int on = 1;
+	check(setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)), "setsockopt(2)");
+	sockaddr_in addr {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	check(bind(listener, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)), "bind(2)"); // NOLINT
+	socklen_t len = sizeof(addr);
+	check(getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len), "getsockname(2)"); // NOLINT
+	boundPort = ntohs(addr.sin_port);
+	check(listen(listener, SOMAXCONN), "listen(2)");
+	watch(epoll, EPOLL_CTL_ADD, listener, EPOLLIN);
+	watch(epoll, EPOLL_CTL_ADD, wake, EPOLLIN);
+	thread = std::thread {&HttpTestServer::run, this};
+}
+
+HttpTestServer::~HttpTestServer()
+{
+	const uint64_t one = 1;
+	if (::write(wake, &one, sizeof(one)) == sizeof(one)) {
+		thread.join();
+	}
+	else {
+		thread.detach(); // LCOV_EXCL_LINE
+	}
+	for (const auto & connection : connections) {
+		close(connection.first);
+	}
+}
+
+uint16_t
+HttpTestServer::port() const
+{
+	return boundPort;
+}
+
+size_t
+HttpTestServer::peakConnections() const
+{
+	return peak;
+}
+
+size_t
+HttpTestServer::acceptedConnections() const
+{
+	return accepted;
+}
+
+size_t
+HttpTestServer::uploadedBytes() const
+{
+	return uploaded;
+}
+
+void
+HttpTestServer::failNext(size_t count, unsigned short status)
+{
+	failStatus = status;
+	failing = count;
+}
+
+void
+HttpTestServer::delayNext(size_t count, std::chrono::milliseconds duration)
+{
+	delay = duration;
+	delaying = count;
+}
+
+size_t
+HttpTestServer::requests() const
+{
+	return answered;
+}
+
+size_t
+HttpTestServer::errors() const
+{
+	return errored;
+}
+
+std::string
+HttpTestServer::lastMethod() const
+{
+	std::lock_guard lock {methodLock};
+	return method;
+}
+
+std::string
+HttpTestServer::url(std::string_view path) const
+{
+	return "http://127.0.0.1:" + std::to_string(boundPort) + std::string(path);
+}
+
+void
+HttpTestServer::run()
+{
+	std::array<epoll_event, 64> events {};
+	while (true) {
+		const auto n = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), timeout());
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		check(n, "epoll_wait(2)");
+		for (int i = 0; i < n; ++i) {
+			const auto fd = events[static_cast<size_t>(i)].data.fd;
+			if (fd == wake) {
+				return;
+			}
+			if (fd == listener) {
+				accept();
+				continue;
+			}
+			auto & connection = connections[fd];
+			if (!read(fd, connection) || !write(fd, connection)) {
+				close(fd);
+				connections.erase(fd);
+			}
+		}
+		// Send any delayed responses now due
+		for (auto c = connections.begin(); c != connections.end();) {
+			if (!c->second.queued.empty() && !write(c->first, c->second)) {
+				close(c->first);
+				c = connections.erase(c);
+			}
+			else {
+				++c;
+			}
+		}
+	}
+}
+
+int
+HttpTestServer::timeout() const
+{
+	auto due = Clock::time_point::max();
+	for (const auto & connection : connections) {
+		if (!connection.second.queued.empty()) {
+			due = std::min(due, connection.second.queued.front().due);
+		}
+	}
+	if (due == Clock::time_point::max()) {
+		return -1;
+	}
+	const auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - Clock::now());
+	return static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0));
+}
+
+void
+HttpTestServer::accept()
+{
+	while (true) {
+		const auto fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			return;
+		}
+		const int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		connections.emplace(fd, Connection {});
+		peak = std::max(peak.load(), connections.size());
+		accepted += 1;
+		watch(epoll, EPOLL_CTL_ADD, fd, EPOLLIN);
+	}
+}
+
+bool
+HttpTestServer::read(int fd, Connection & connection)
+{
+	std::array<char, 4096> buf {};
+	while (true) {
+		const auto r = ::read(fd, buf.data(), buf.size());
+		if (r == 0) {
+			return false;
+		}
+		if (r < 0) {
+			if (errno == EAGAIN) {
+				break;
+			}
+			return false;
+		}
+		connection.in.append(buf.data(), static_cast<size_t>(r));
+	}
+	consume(connection);
+	return true;
+}
+
+void
+HttpTestServer::consume(Connection & connection)
+{
+	auto & in = connection.in;
+	// Answer every complete request received
+	while (true) {
+		switch (connection.state) {
+			case State::Headers: {
+				const auto end = in.find("\r\n\r\n");
+				if (end == std::string::npos) {
+					return;
+				}
+				std::string headers {in.substr(0, end + 2)};
+				{
+					std::lock_guard lock {methodLock};
+					method = headers.substr(0, headers.find(' '));
+				}
+				std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+				in.erase(0, end + 4);
+				if (headers.find("\r\nexpect: 100-continue\r\n") != std::string::npos) {
+					connection.out += "HTTP/1.1 100 Continue\r\n\r\n";
+				}
+				if (const auto cl = headers.find("\r\ncontent-length:"); cl != std::string::npos) {
+					connection.remaining = std::stoul(headers.substr(cl + 17));
+					connection.state = State::Body;
+				}
+				else if (headers.find("\r\ntransfer-encoding: chunked\r\n") != std::string::npos) {
+					connection.state = State::ChunkSize;
+				}
+				else {
+					respond(connection);
+				}
+				break;
+			}
+			case State::Body:
+			case State::ChunkData: {
+				const auto n = std::min(connection.remaining, in.length());
+				in.erase(0, n);
+				uploaded += n;
+				connection.remaining -= n;
+				if (connection.remaining) {
+					return;
+				}
+				if (connection.state == State::ChunkData) {
+					connection.state = State::ChunkEnd;
+				}
+				else {
+					respond(connection);
+					connection.state = State::Headers;
+				}
+				break;
+			}
+			case State::ChunkSize: {
+				const auto eol = in.find("\r\n");
+				if (eol == std::string::npos) {
+					return;
+				}
+				connection.remaining = std::stoul(in.substr(0, eol), nullptr, 16);
+				in.erase(0, eol + 2);
+				connection.state = connection.remaining ? State::ChunkData : State::Trailer;
+				break;
+			}
+			case State::ChunkEnd:
+				if (in.length() < 2) {
+					return;
+				}
+				in.erase(0, 2);
+				connection.state = State::ChunkSize;
+				break;
+			case State::Trailer: {
+				const auto eol = in.find("\r\n");
+				if (eol == std::string::npos) {
+					return;
+				}
+				in.erase(0, eol + 2);
+				if (eol == 0) {
+					respond(connection);
+					connection.state = State::Headers;
+				}
+				break;
+			}
+		}
+	}
+}
+
+void
+HttpTestServer::respond(Connection & connection)
+{
+	const std::string * content = &response;
+	if (take(failing)) {
+		content = &failure(failStatus);
+	}
+	else if (options.errorRate > 0 && erroring(random)) {
+		content = &failure(options.errorStatus);
+	}
+	answered += 1;
+	errored += (content != &response);
+	auto due = Clock::now() + options.latency;
+	if (take(delaying)) {
+		due += delay.load();
+	}
+	connection.queued.push_back({due, content});
+}
+
+const std::string &
+HttpTestServer::failure(unsigned short status)
+{
+	auto & failure = failures[status];
+	if (failure.empty()) {
+		failure = "HTTP/1.1 " + std::to_string(status) + " Test Failure\r\nContent-Length: 0\r\n\r\n";
+	}
+	return failure;
+}
+
+bool
+HttpTestServer::write(int fd, Connection & connection)
+{
+	// Release responses now due, in order
+	const auto now = Clock::now();
+	while (!connection.queued.empty() && connection.queued.front().due <= now) {
+		connection.out += *connection.queued.front().content;
+		connection.queued.pop_front();
+	}
+	while (connection.written < connection.out.length()) {
+		const auto w = ::write(fd, connection.out.data() + connection.written, connection.out.length() - connection.written);
+		if (w < 0) {
+			if (errno == EAGAIN) {
+				break;
+			}
+			return false;
+		}
+		connection.written += static_cast<size_t>(w);
+	}
+	const bool pending = connection.written < connection.out.length();
+	if (!pending) {
+		connection.out.clear();
+		connection.written = 0;
+	}
+	if (pending != connection.writing) {
+		connection.writing = pending;
+		watch(epoll, EPOLL_CTL_MOD, fd, pending ? EPOLLIN | EPOLLOUT : EPOLLIN);
+	}
+	return true;
+}
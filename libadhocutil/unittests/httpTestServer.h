@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <c++11Helpers.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fileUtils.h>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/// Minimal in-process HTTP/1.1 server on the loopback interface, for exercising the curl layer without a network.
+/// Every request is answered with the same body; connections are kept alive. Request bodies (sized or
+/// chunked) are read and discarded. Latency, chunked responses and a rate of errors can be set for all responses,
+/// and failures and delays injected into upcoming ones.
+class HttpTestServer {
+public:
+	/// How every response is served.
+	struct Options {
+		/// Delay before each response is sent (to the millisecond, rounding up).
+		std::chrono::microseconds latency {};
+		/// Send bodies with chunked transfer encoding, in chunks of this size; 0 to send a Content-Length.
+		size_t chunkSize {};
+		/// Fraction (0-1) of requests answered with errorStatus instead, at random (but repeatably).
+		double errorRate {};
+		/// The status of those error responses.
+		unsigned short errorStatus {503};
+	};
+
+	/// Start serving responses of the given body size on an ephemeral port.
+	explicit HttpTestServer(size_t bodySize = 1024);
+	/// Start serving responses of the given body size, as the options specify.
+	HttpTestServer(size_t bodySize, const Options &);
+	/// Start serving responses of the given body, optionally declared as of the given Content-Encoding.
+	explicit HttpTestServer(std::string_view body, std::string_view contentEncoding = {});
+	/// Start serving responses of the given body, declared as of the given Content-Encoding (if any), as the
+	/// options specify.
+	HttpTestServer(std::string_view body, std::string_view contentEncoding, const Options &);
+	~HttpTestServer();
+	SPECIAL_MEMBERS_DELETE(HttpTestServer);
+
+	/// The port being listened on.
+	[[nodiscard]] uint16_t port() const;
+	/// A URL for the given path on this server.
+	[[nodiscard]] std::string url(std::string_view path = "/") const;
+	/// The most connections open at once so far.
+	[[nodiscard]] size_t peakConnections() const;
+	/// The number of connections accepted so far.
+	[[nodiscard]] size_t acceptedConnections() const;
+	/// The number of request body bytes received so far.
+	[[nodiscard]] size_t uploadedBytes() const;
+	/// The number of requests answered so far (successfully or not).
+	[[nodiscard]] size_t requests() const;
+	/// The number of those answered with an error.
+	[[nodiscard]] size_t errors() const;
+	/// The method of the last request received (empty before any).
+	[[nodiscard]] std::string lastMethod() const;
+
+	/// Answer the next count requests with the given (error) status and no body.
+	void failNext(size_t count, unsigned short status = 503);
+	/// Hold back the responses to the next count requests for the given time; later responses on the same
+	/// connection wait behind them.
+	void delayNext(size_t count, std::chrono::milliseconds);
+
+private:
+	using Clock = std::chrono::steady_clock;
+	enum class State { Headers, Body, ChunkSize, ChunkData, ChunkEnd, Trailer };
+
+	struct Response {
+		Clock::time_point due;
+		const std::string * content;
+	};
+
+	struct Connection {
+		std::string in, out;
+		std::deque<Response> queued;
+		size_t written {};
+		bool writing {};
+		State state {State::Headers};
+		size_t remaining {};
+	};
+
+	void run();
+	void accept();
+	bool read(int fd, Connection &);
+	void consume(Connection &);
+	void respond(Connection &);
+	bool write(int fd, Connection &);
+	[[nodiscard]] int timeout() const;
+	const std::string & failure(unsigned short status);
+
+	AdHoc::FileUtils::FileHandle listener, epoll, wake;
+	uint16_t boundPort {};
+	std::string response;
+	std::map<unsigned short, std::string> failures;
+	std::map<int, Connection> connections;
+	const Options options;
+	std::minstd_rand random {};
+	std::bernoulli_distribution erroring;
+	std::atomic<size_t> peak {}, accepted {}, uploaded {}, answered {}, errored {}, failing {}, delaying {};
+	std::atomic<unsigned short> failStatus {};
+	std::atomic<Clock::duration> delay {};
+	mutable std::mutex methodLock;
+	std::string method;
+	std::thread thread;
+};
@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+
+#include "compileTimeFormatter.h"
+#include "ctf-impl/printf-compat.h"
+#include <array>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+using namespace AdHoc;
+
+template<const support::basic_fixed_string Fmt, typename... Pn>
+static void
+ctfGet(benchmark::State & state, const Pn &... pn)
+{
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(LiteralFormatter<Fmt>::get(pn...));
+	}
+}
+
+template<const support::basic_fixed_string Fmt, typename... Pn>
+static void
+ctfWriteTo(benchmark::State & state, const Pn &... pn)
+{
+	std::array<char, 128> buf {};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(LiteralFormatter<Fmt>::writeTo(buf, pn...));
+	}
+}
+
+// Per conversion comparison of:
+//  - ctfGet: CTF to std::string
+//  - ctfWriteTo: CTF into a stack buffer
+//  - snprintf: libc into a stack buffer
+//  - iostream: manipulators and copyfmt reset, as the conversions were previously implemented
+#define CONVERSION(NAME, FMT, STREAMOP, ...) \
+	static void ctfGet_##NAME(benchmark::State & state) \
+	{ \
+		ctfGet<FMT>(state, __VA_ARGS__); \
+	} \
+	BENCHMARK(ctfGet_##NAME); \
+	static void ctfWriteTo_##NAME(benchmark::State & state) \
+	{ \
+		ctfWriteTo<FMT>(state, __VA_ARGS__); \
+	} \
+	BENCHMARK(ctfWriteTo_##NAME); \
+	static void snprintf_##NAME(benchmark::State & state) \
+	{ \
+		std::array<char, 128> buf {}; \
+		for (auto _ : state) { \
+			benchmark::DoNotOptimize(snprintf(buf.data(), buf.size(), FMT, __VA_ARGS__)); \
+		} \
+	} \
+	BENCHMARK(snprintf_##NAME); \
+	static void iostream_##NAME(benchmark::State & state) \
+	{ \
+		for (auto _ : state) { \
+			std::stringstream s; \
+			STREAMOP; \
+			s.copyfmt(std::ios(nullptr)); \
+			benchmark::DoNotOptimize(s.str()); \
+		} \
+	} \
+	BENCHMARK(iostream_##NAME)
+
+CONVERSION(d, "%d", s << std::dec << -123456, -123456);
+CONVERSION(d_width, "%08d", s << std::setfill('0') << std::setw(8) << std::dec << 123456, 123456);
+CONVERSION(u, "%lu", s << std::dec << 1234567890UL, 1234567890UL);
+CONVERSION(x, "%#x", s << std::showbase << std::hex << 0xbeefU, 0xbeefU);
+CONVERSION(o, "%o", s << std::oct << 01234U, 01234U);
+CONVERSION(f, "%.3f", s << std::setprecision(3) << std::fixed << 1234.5678, 1234.5678);
+CONVERSION(e, "%e", s << std::scientific << 1234.5678, 1234.5678);
+CONVERSION(g, "%g", s << std::defaultfloat << 1234.5678, 1234.5678);
+CONVERSION(a, "%a", s << std::hexfloat << 1234.5678, 1234.5678);
+CONVERSION(s, "%s", s << "some string value", "some string value");
+CONVERSION(s_width, "%-20s", s << std::left << std::setw(20) << "some string", "some string");
+CONVERSION(c, "%c", s << 'c', 'c');
+CONVERSION(mixed, "%s: %d/%u %#x %.3f", s << "mixed" << ": " << std::dec << -42 << '/' << 42U << ' ' << std::showbase
+				<< std::hex << 0xbeefU << ' ' << std::setprecision(3) << std::fixed << 1234.5678,
+		"mixed", -42, 42U, 0xbeefU, 1234.5678);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,23 @@
+// Build cost benchmark: defines FORMATTERS (<= 256) distinct formatters, each
+// mixing literal text, default and printf-compat conversions.
+// Compile with ctfBuildCost.sh to report compile time and object size.
+#include "compileTimeFormatter.h"
+#include "ctf-impl/printf-compat.h"
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/repetition/repeat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+#include <string>
+
+#ifndef FORMATTERS
+#	define FORMATTERS 64
+#endif
+
+#define FORMATTER(z, n, data) \
+	std::string BOOST_PP_CAT(format, n)(int i, const std::string & s, double d); \
+	std::string BOOST_PP_CAT(format, n)(int i, const std::string & s, double d) \
+	{ \
+		return AdHoc::LiteralFormatter<"Formatter " BOOST_PP_STRINGIZE( \
+				n) " int %d, string %s, default %?, float %.3f, hex %#x, then some trailing text.">:: \
+				get(i, s, s, d, static_cast<unsigned int>(i)); \
+	}
+BOOST_PP_REPEAT(FORMATTERS, FORMATTER, void)
@@ -0,0 +1,315 @@
+#include <benchmark/benchmark.h>
+
+#include "curlClient.h"
+#include "curlDecoding.h"
+#include "curlHandlePool.h"
+#include "curlMultiHandle.h"
+#include "curlStream.h"
+#include "fileUtils.h"
+#include "httpTestServer.h"
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <istream>
+#include <limits>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// Common to the single, multi and stream benchmarks, all against a loopback server, which report:
+// * items_per_second: transfers (requests) per second
+// * bytes_per_second: response bytes received per second
+// * cpu_per_transfer: CPU time (in microseconds) used by the client, excluding the server's thread
+
+// CPU time used so far by the calling thread
+static std::chrono::nanoseconds
+threadCpuTime()
+{
+	timespec ts {};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return std::chrono::seconds {ts.tv_sec} + std::chrono::nanoseconds {ts.tv_nsec};
+}
+
+static void
+reportTransfers(benchmark::State & state, size_t transfers, size_t bytes, std::chrono::nanoseconds cpu)
+{
+	state.SetItemsProcessed(static_cast<int64_t>(transfers));
+	state.SetBytesProcessed(static_cast<int64_t>(bytes));
+	state.counters["cpu_per_transfer"] = transfers
+			? std::chrono::duration<double, std::micro> {cpu}.count() / static_cast<double>(transfers)
+			: 0.0;
+}
+
+// Server behaviour from the benchmark's args, starting at the given index:
+// latency (microseconds), chunk size (0 for Content-Length), error rate (per mille)
+static HttpTestServer::Options
+serverOptions(const benchmark::State & state, size_t first)
+{
+	return {.latency = std::chrono::microseconds {state.range(first)},
+			.chunkSize = static_cast<size_t>(state.range(first + 1)),
+			.errorRate = static_cast<double>(state.range(first + 2)) / 1000};
+}
+
+// Each transfer in flight holds a descriptor at both ends of its loopback connection, so thousands
+// of them need more than the usual soft limit of 1024; raise it as far as the hard limit allows
+static void
+raiseFileLimit(size_t concurrency)
+{
+	rlimit limit {};
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < concurrency * 2 + 64) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+// Many queued transfers through CurlMultiHandle; failures (from the error rate) are retried
+// Args: transfers, body size, concurrency (0 for adaptive, up to 200), then server options
+static void
+multi(benchmark::State & state)
+{
+	const auto transfers = static_cast<size_t>(state.range(0));
+	const auto bodySize = static_cast<size_t>(state.range(1));
+	const auto concurrency = static_cast<size_t>(state.range(2));
+	raiseFileLimit(concurrency);
+	HttpTestServer server {bodySize, serverOptions(state, 3)};
+	const auto url = server.url();
+	size_t bytes = 0;
+	const auto cpu = threadCpuTime();
+	for (auto _ : state) {
+		AdHoc::Net::CurlMultiHandle cmh {{.transfers = concurrency ? concurrency : 200, .adaptive = !concurrency}};
+		cmh.retry = {.attempts = 10, .backoff = std::chrono::milliseconds {1}};
+		for (size_t i = 0; i < transfers; ++i) {
+			cmh.addCurl(url, [&bytes](std::istream & s) {
+				s.ignore(std::numeric_limits<std::streamsize>::max());
+				bytes += static_cast<size_t>(s.gcount());
+			});
+		}
+		cmh.performAll();
+	}
+	reportTransfers(state, static_cast<size_t>(state.iterations()) * transfers, bytes, threadCpuTime() - cpu);
+	state.counters["attempts_per_transfer"]
+			= static_cast<double>(server.requests()) / static_cast<double>(state.iterations() * state.range(0));
+}
+
+BENCHMARK(multi)
+		->ArgNames({"transfers", "size", "concurrency", "latency", "chunk", "errors"})
+		->ArgsProduct({{4000}, {1024}, {1, 5, 50, 200, 2000, 0}, {0}, {0}, {0}})
+		->Args({200, 1 << 20, 5, 0, 0, 0})
+		->Args({200, 1 << 20, 50, 0, 0, 0})
+		->Args({200, 1 << 20, 0, 0, 0, 0})
+		->Args({1000, 1024, 50, 1000, 0, 0})
+		->Args({1000, 1024, 50, 0, 256, 0})
+		->Args({1000, 1024, 50, 0, 0, 20})
+		->Args({1000, 1024, 50, 1000, 256, 20})
+		->Unit(benchmark::kMillisecond)
+		->UseRealTime();
+
+// Batches of transfers of which a few are slow to respond, as from an overloaded server
+// Arg: hedging percentile (0 for no hedging)
+static void
+hedged(benchmark::State & state)
+{
+	HttpTestServer server;
+	const auto url = server.url();
+	for (auto _ : state) {
+		AdHoc::Net::CurlMultiHandle cmh {{.transfers = 10}};
+		cmh.hedging = {.percentile = static_cast<double>(state.range(0)),
+				.initialDelay = std::chrono::milliseconds {20}};
+		server.delayNext(5, std::chrono::milliseconds {200});
+		for (size_t i = 0; i < 100; ++i) {
+			cmh.addCurl(url, [](std::istream & s) {
+				s.ignore(std::numeric_limits<std::streamsize>::max());
+			});
+		}
+		cmh.performAll();
+	}
+	state.SetItemsProcessed(state.iterations() * 100);
+}
+
+BENCHMARK(hedged)->Arg(0)->Arg(95)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static size_t
+discard(void *, size_t sz, size_t nm, void *)
+{
+	return sz * nm;
+}
+
+// Sequential transfers on a fresh handle each, paying for a new connection each time
+static void
+singleFresh(benchmark::State & state)
+{
+	HttpTestServer server;
+	const auto url = server.url();
+	const auto cpu = threadCpuTime();
+	for (auto _ : state) {
+		AdHoc::Net::CurlHandle ch {url};
+		ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+		ch.perform();
+	}
+	reportTransfers(state, static_cast<size_t>(state.iterations()), static_cast<size_t>(state.iterations()) * 1024,
+			threadCpuTime() - cpu);
+}
+
+BENCHMARK(singleFresh);
+
+// Sequential transfers on pooled handles, reusing connections
+// Args: server options
+static void
+singlePooled(benchmark::State & state)
+{
+	HttpTestServer server {1024, serverOptions(state, 0)};
+	const auto url = server.url();
+	AdHoc::Net::CurlHandlePool pool {1, 1};
+	const auto cpu = threadCpuTime();
+	for (auto _ : state) {
+		auto ch = pool.get(url);
+		ch->setopt(CURLOPT_WRITEFUNCTION, discard);
+		// Error responses (from the error rate) are transfers too
+		ch->setopt(CURLOPT_FAILONERROR, 0L);
+		ch->perform();
+	}
+	reportTransfers(state, static_cast<size_t>(state.iterations()), (server.requests() - server.errors()) * 1024,
+			threadCpuTime() - cpu);
+}
+
+BENCHMARK(singlePooled)
+		->ArgNames({"latency", "chunk", "errors"})
+		->Args({0, 0, 0})
+		->Args({1000, 0, 0})
+		->Args({0, 256, 0})
+		->Args({0, 0, 20})
+		->UseRealTime();
+
+// A single large download through CurlStreamSource
+// Args: body size, chunk size (0 for Content-Length)
+static void
+stream(benchmark::State & state)
+{
+	const auto bodySize = static_cast<size_t>(state.range(0));
+	HttpTestServer server {bodySize, {.chunkSize = static_cast<size_t>(state.range(1))}};
+	const auto url = server.url();
+	const auto cpu = threadCpuTime();
+	for (auto _ : state) {
+		AdHoc::Net::CurlStreamSource css {url};
+		AdHoc::Net::CurlStream curlstrm {css};
+		curlstrm.ignore(std::numeric_limits<std::streamsize>::max());
+	}
+	reportTransfers(state, static_cast<size_t>(state.iterations()), static_cast<size_t>(state.iterations()) * bodySize,
+			threadCpuTime() - cpu);
+}
+
+BENCHMARK(stream)
+		->ArgNames({"size", "chunk"})
+		->Args({64 << 20, 0})
+		->Args({64 << 20, 16 << 10})
+		->Args({64 << 20, 1 << 10})
+		->Unit(benchmark::kMillisecond)
+		->UseRealTime();
+
+// A single large upload streamed from a file descriptor; arg: body size
+static void
+upload(benchmark::State & state)
+{
+	const auto path = std::filesystem::temp_directory_path() / "perfCurl.upload";
+	std::ofstream {path} << std::string(static_cast<size_t>(state.range(0)), 'y');
+	HttpTestServer server;
+	const auto url = server.url();
+	for (auto _ : state) {
+		AdHoc::FileUtils::FileHandle fh {path};
+		AdHoc::Net::CurlHandle ch {url};
+		ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+		ch.setBody(fh);
+		ch.perform();
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+	std::filesystem::remove(path);
+}
+
+BENCHMARK(upload)->Arg(64 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Decoding and splitting into lines a large compressed file:// fixture
+// Arg: content encoding (as AdHoc::Net::ContentEncoding)
+static void
+decode(benchmark::State & state)
+{
+	using AdHoc::Net::ContentEncoding;
+	const auto encoding = static_cast<ContentEncoding>(state.range(0));
+	const auto path = std::filesystem::temp_directory_path() / "perfCurl.decode";
+	size_t contentSize = 0;
+	{
+		boost::iostreams::filtering_ostream out;
+		switch (encoding) {
+			case ContentEncoding::Identity:
+				break;
+			case ContentEncoding::Gzip:
+				out.push(boost::iostreams::gzip_compressor {});
+				break;
+			case ContentEncoding::Deflate:
+				out.push(boost::iostreams::zlib_compressor {});
+				break;
+			case ContentEncoding::Zstd:
+				out.push(boost::iostreams::zstd_compressor {});
+				break;
+		}
+		out.push(boost::iostreams::file_sink {path.string()});
+		for (size_t i = 0; i < 1000000; ++i) {
+			const auto line = "record " + std::to_string(i) + " of the compressed fixture, with some padding\n";
+			out << line;
+			contentSize += line.length();
+		}
+	}
+	size_t records = 0;
+	for (auto _ : state) {
+		AdHoc::Net::CurlStreamSource css {"file://" + path.string()};
+		AdHoc::Net::CurlDecodingStream decoded {css, encoding};
+		AdHoc::Net::CurlRecordReader reader {decoded};
+		while (const auto record = reader.next()) {
+			benchmark::DoNotOptimize(record->data());
+			records += 1;
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(records));
+	state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(contentSize));
+	std::filesystem::remove(path);
+}
+
+BENCHMARK(decode)
+		->Arg(static_cast<int>(AdHoc::Net::ContentEncoding::Identity))
+		->Arg(static_cast<int>(AdHoc::Net::ContentEncoding::Gzip))
+		->Arg(static_cast<int>(AdHoc::Net::ContentEncoding::Deflate))
+		->Arg(static_cast<int>(AdHoc::Net::ContentEncoding::Zstd))
+		->Unit(benchmark::kMillisecond)
+		->UseRealTime();
+
+// Batches of transfers through the asynchronous client's futures; arg: batch size
+static void
+client(benchmark::State & state)
+{
+	HttpTestServer server;
+	const auto url = server.url();
+	AdHoc::Net::CurlClient cc {{.transfers = 50}};
+	std::vector<std::future<AdHoc::Net::CurlResponse>> responses;
+	for (auto _ : state) {
+		for (auto i = state.range(0); i > 0; --i) {
+			responses.push_back(cc.fetch(url));
+		}
+		for (auto & r : responses) {
+			benchmark::DoNotOptimize(r.get());
+		}
+		responses.clear();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(client)->Arg(1)->Arg(100)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include "lexer-matchers.h"
+#include "lexer-regex.h"
+#include <cstddef>
+#include <string>
+
+using namespace AdHoc;
+using namespace AdHoc::LexerMatchers;
+
+static std::string
+sampleInput()
+{
+	std::string input;
+	for (auto i = 0; i < 100; ++i) {
+		input += "if (identifier" + std::to_string(i) + " >= 12345) { value = \"string literal\"; } else { x += 1.5; }\n";
+	}
+	return input;
+}
+
+static Lexer
+sampleLexer(size_t & tokens)
+{
+	auto count = [&tokens](auto) {
+		tokens += 1;
+	};
+	return Lexer {{
+			{{Lexer::InitialState}, regex("if|else|while|for|return"), count},
+			{{Lexer::InitialState}, regex("[A-Za-z_][A-Za-z0-9_]*"), count},
+			{{Lexer::InitialState}, regex("[0-9]+\\.[0-9]+"), count},
+			{{Lexer::InitialState}, regex("[0-9]+"), count},
+			{{Lexer::InitialState}, regex("\"[^\"]*\""), count},
+			{{Lexer::InitialState}, regex(">=|<=|==|!=|\\+=|-="), count},
+			{{Lexer::InitialState}, regex("[-+*/=<>(){};]"), count},
+			{{Lexer::InitialState}, regex("\\s+"), [](auto) {}},
+	}};
+}
+
+// As sampleLexer, using only non-regex matchers; numbers are a single run and strings use a state
+static Lexer
+sampleMatcherLexer(size_t & tokens)
+{
+	auto count = [&tokens](auto) {
+		tokens += 1;
+	};
+	return Lexer {{
+			{{Lexer::InitialState}, literals({"if", "else", "while", "for", "return"}), count},
+			{{Lexer::InitialState}, charRun("A-Za-z_", "A-Za-z0-9_"), count},
+			{{Lexer::InitialState}, charRun("0-9", "0-9."), count},
+			{{Lexer::InitialState}, literal("\""),
+					[](auto es) {
+						es->pushState("string");
+					}},
+			{{"string"}, charRun("^\""), count},
+			{{"string"}, literal("\""),
+					[](auto es) {
+						es->popState();
+					}},
+			{{Lexer::InitialState}, literals({">=", "<=", "==", "!=", "+=", "-="}), count},
+			{{Lexer::InitialState}, charClass("-+*/=<>(){};"), count},
+			{{Lexer::InitialState}, charRun(" \t\n"), [](auto) {}},
+	}};
+}
+
+static void
+lexer(benchmark::State & state, bool compile, bool matchers)
+{
+	const auto input = sampleInput();
+	size_t tokens = 0;
+	auto l = matchers ? sampleMatcherLexer(tokens) : sampleLexer(tokens);
+	if (compile) {
+		l.compile();
+	}
+	for (auto _ : state) {
+		l.extract(input.c_str(), input.length());
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(tokens));
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.length()));
+}
+
+BENCHMARK_CAPTURE(lexer, rules, false, false);
+BENCHMARK_CAPTURE(lexer, compiled, true, false);
+BENCHMARK_CAPTURE(lexer, matchers, false, true);
+BENCHMARK_CAPTURE(lexer, matchersCompiled, true, true);
+
+BENCHMARK_MAIN();
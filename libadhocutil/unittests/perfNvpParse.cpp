@@ -0,0 +1,75 @@
+#include <benchmark/benchmark.h>
+
+#include "nvpParse.h"
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace AdHoc;
+
+class Record {
+public:
+	std::string name;
+	std::string host;
+	int port {0};
+	unsigned long id {0};
+	double weight {0};
+};
+
+NvpTarget(Record) RecordMap {
+		NvpValue(Record, name),
+		NvpValue(Record, host),
+		NvpValue(Record, port),
+		NvpValue(Record, id),
+		NvpValue(Record, weight),
+};
+
+static constexpr std::string_view record {"name=service;host=example.com;port=8080;id=1234567890;weight=0.75;"};
+
+static void
+viewTable(benchmark::State & state)
+{
+	const NvpParse::Table<Record> table {RecordMap};
+	for (auto _ : state) {
+		Record r;
+		NvpParse::parse(record, table, r);
+		benchmark::DoNotOptimize(r);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(viewTable);
+
+static void
+streamTargetMap(benchmark::State & state)
+{
+	for (auto _ : state) {
+		Record r;
+		std::stringstream in {std::string {record}};
+		NvpParse::parse(in, RecordMap, r);
+		benchmark::DoNotOptimize(r);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(streamTargetMap);
+
+static void
+records(benchmark::State & state)
+{
+	const NvpParse::Table<Record> table {RecordMap};
+	constexpr auto RECORDS = 100000U;
+	std::string in;
+	in.reserve(RECORDS * (record.length() + 1));
+	for (auto i = 0U; i < RECORDS; ++i) {
+		in.append(record).append(1, '\n');
+	}
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(NvpParse::parseRecords(in, table, static_cast<unsigned int>(state.range(0))));
+	}
+	state.SetItemsProcessed(state.iterations() * RECORDS);
+}
+
+BENCHMARK(records)->Arg(1)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -5,6 +5,7 @@
 #include <boost/format.hpp>
 #include <cstring>
 #include <iosfwd>
+#include <sstream>
 #include <string>
 #include <string_view>
 
@@ -81,6 +82,87 @@ BOOST_AUTO_TEST_CASE(writeto)
 	BOOST_REQUIRE_EQUAL(buf, "string a b num 1 num 2");
 }
 
+BOOST_AUTO_TEST_CASE(writetoOffset)
+{
+	Buffer b;
+	b.append("string a").append(std::string(" b")).appendf(" num %d", 1).appendbf(" num %d", 2);
+	std::string buf(22, 'x');
+	b.writeto(buf.data(), 22, 3);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), "ing a b num 1 num 2");
+	b.writeto(buf.data(), 22, 8);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), " b num 1 num 2");
+	b.writeto(buf.data(), 22, 10);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), " num 1 num 2");
+	b.writeto(buf.data(), 22, 22);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), "");
+	b.writeto(buf.data(), 22, 30);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), "");
+}
+
+BOOST_AUTO_TEST_CASE(writetoTruncated)
+{
+	Buffer b;
+	b.append("string a").append(std::string(" b")).appendf(" num %d", 1);
+	std::string buf(22, 'x');
+	b.writeto(buf.data(), 9, 0);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), "string a ");
+	b.writeto(buf.data(), 5, 6);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), " a b ");
+}
+
+BOOST_AUTO_TEST_CASE(readto)
+{
+	Buffer b;
+	b.append("string a").append(std::string(" b")).appendf(" num %d", 1);
+	std::string buf(8, 'x');
+	BOOST_REQUIRE_EQUAL(b.readto(buf.data(), 5, 0), 5);
+	BOOST_REQUIRE_EQUAL(buf, "strinxxx");
+	BOOST_REQUIRE_EQUAL(b.readto(buf.data(), 8, 5), 8);
+	BOOST_REQUIRE_EQUAL(buf, "g a b nu");
+	BOOST_REQUIRE_EQUAL(b.readto(buf.data(), 8, 13), 3);
+	BOOST_REQUIRE_EQUAL(buf, "m 1 b nu");
+	BOOST_REQUIRE_EQUAL(b.readto(buf.data(), 8, 16), 0);
+}
+
+BOOST_AUTO_TEST_CASE(flattenAppend)
+{
+	Buffer b;
+	b.append("one ").append(std::string("two "));
+	BOOST_REQUIRE_EQUAL(static_cast<const char *>(b), std::string_view {"one two "});
+	b.append("three ");
+	Buffer copy {b};
+	b.append("four");
+	BOOST_REQUIRE_EQUAL(static_cast<const char *>(b), std::string_view {"one two three four"});
+	BOOST_REQUIRE_EQUAL(b.length(), 18);
+	// Sharing flattened content with a copy does not affect the copy
+	BOOST_REQUIRE_EQUAL(copy.str(), "one two three ");
+	BOOST_REQUIRE_EQUAL(static_cast<const char *>(copy), std::string_view {"one two three "});
+	b.append(" five");
+	BOOST_REQUIRE_EQUAL(static_cast<const char *>(b), std::string_view {"one two three four five"});
+	BOOST_REQUIRE_EQUAL(static_cast<const char *>(copy), std::string_view {"one two three "});
+	std::stringstream out;
+	out << b << copy;
+	BOOST_REQUIRE_EQUAL(out.str(), "one two three four fiveone two three ");
+}
+
+BOOST_AUTO_TEST_CASE(manyFragments)
+{
+	Buffer b;
+	std::string expected;
+	for (int n = 0; n < 1000; ++n) {
+		const auto s = std::to_string(n);
+		b.append(s);
+		expected += s;
+	}
+	BOOST_REQUIRE_EQUAL(b.length(), expected.length());
+	std::string buf(10, 'x');
+	b.writeto(buf.data(), 9, 1000);
+	BOOST_REQUIRE_EQUAL(buf.c_str(), expected.substr(1000, 9));
+	BOOST_REQUIRE_EQUAL(b.str(), expected);
+	b.clear();
+	BOOST_REQUIRE_EQUAL(b.length(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(operators)
 {
 	auto expected = "cstringstd::string";
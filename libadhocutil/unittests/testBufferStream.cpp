@@ -0,0 +1,116 @@
+#define BOOST_TEST_MODULE BufferStream
+#include <boost/test/unit_test.hpp>
+
+#include "buffer.h"
+#include "bufferStream.h"
+#include "compileTimeFormatter.h"
+#include "fprintbf.h"
+#include <cstdio>
+#include <malloc.h>
+#include <ostream>
+#include <string>
+
+using namespace AdHoc;
+
+BOOST_FIXTURE_TEST_SUITE(s, Buffer)
+
+BOOST_AUTO_TEST_CASE(stream_empty)
+{
+	{
+		BufferStream strm {*this};
+	}
+	BOOST_CHECK(this->empty());
+}
+
+BOOST_AUTO_TEST_CASE(stream_simple)
+{
+	BufferStream strm {*this};
+	strm << "Some " << 42 << " things.";
+	strm.flush();
+	BOOST_CHECK_EQUAL(this->str(), "Some 42 things.");
+}
+
+BOOST_AUTO_TEST_CASE(stream_destroy_appends)
+{
+	this->append("Before ");
+	{
+		BufferStream strm {*this};
+		strm << "during";
+	}
+	this->append(" after");
+	BOOST_CHECK_EQUAL(this->str(), "Before during after");
+}
+
+BOOST_AUTO_TEST_CASE(stream_chunks)
+{
+	std::string expected;
+	{
+		BufferStream strm {*this, 16};
+		for (int n = 0; n < 100; ++n) {
+			strm << n << ',';
+			expected += std::to_string(n) + ',';
+		}
+		strm << std::string(40, 'x');
+		expected += std::string(40, 'x');
+	}
+	BOOST_CHECK_EQUAL(this->length(), expected.length());
+	BOOST_CHECK_EQUAL(this->str(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(stream_small_syncs)
+{
+	// Flushed per line, each line costs about its own length, not a whole chunk
+	const auto allocated = [] {
+		const auto mi = mallinfo2();
+		return mi.uordblks + mi.hblkhd;
+	};
+	const auto before = allocated();
+	{
+		BufferStream strm {*this};
+		for (int n = 0; n < 10000; ++n) {
+			strm << "line " << n << std::endl;
+		}
+	}
+	BOOST_CHECK_EQUAL(this->length(), 10000 * 6 + 10 + 90 * 2 + 900 * 3 + 9000 * 4);
+	BOOST_CHECK_LT(allocated() - before, 10000 * 256);
+}
+
+AdHocFormatter(BufferStreamFmt, "Formatted %? into %?.");
+
+BOOST_AUTO_TEST_CASE(stream_formatter)
+{
+	{
+		BufferStream strm {*this};
+		BufferStreamFmt::write(strm, 1, "buffer");
+	}
+	BOOST_CHECK_EQUAL(this->str(), "Formatted 1 into buffer.");
+}
+
+BOOST_AUTO_TEST_CASE(file_simple)
+{
+	{
+		BufferFile f {*this};
+		BOOST_CHECK_EQUAL(fprintf(f, "Some %s write.", "simple"), 18);
+	}
+	BOOST_CHECK_EQUAL(this->str(), "Some simple write.");
+}
+
+BOOST_AUTO_TEST_CASE(file_fprintbf)
+{
+	BufferFile f {*this};
+	fprintbf(f, "Some %s write %d.", "boost::format", 2);
+	fflush(f);
+	BOOST_CHECK_EQUAL(this->str(), "Some boost::format write 2.");
+}
+
+BOOST_AUTO_TEST_CASE(file_large)
+{
+	const std::string big(BUFSIZ * 3, 'y');
+	{
+		BufferFile f {*this};
+		fprintss(f, big);
+	}
+	BOOST_CHECK_EQUAL(this->str(), big);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
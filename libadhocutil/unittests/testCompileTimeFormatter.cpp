@@ -3,6 +3,7 @@
 
 #include "compileTimeFormatter.h"
 #include "memstream.h"
+#include <array>
 #include <boost/assert.hpp>
 #include <cstdint>
 #include <cstdio>
@@ -11,6 +12,7 @@
 #include <definedDirs.h>
 #include <fileUtils.h>
 #include <iostream>
+#include <limits>
 #include <locale>
 #include <memory>
 #include <string>
@@ -286,6 +288,48 @@ BOOST_AUTO_TEST_CASE(filestar)
 	BOOST_CHECK_EQUAL(strm.sv(), "First file, then star.");
 }
 
+BOOST_AUTO_TEST_CASE(writeToSpan)
+{
+	std::array<char, 32> buf {};
+	auto len = Formatter<formatStringMulti>::writeTo(buf, "one", "two");
+	BOOST_REQUIRE(len);
+	BOOST_CHECK_EQUAL(*len, 20);
+	BOOST_CHECK_EQUAL(std::string_view(buf.data(), *len), "First one, then two.");
+}
+
+BOOST_AUTO_TEST_CASE(writeToSpanExact)
+{
+	std::array<char, 20> buf {};
+	auto len = Formatter<formatStringMulti>::writeTo(buf, "one", "two");
+	BOOST_REQUIRE(len);
+	BOOST_CHECK_EQUAL(*len, 20);
+}
+
+BOOST_AUTO_TEST_CASE(writeToSpanTruncated)
+{
+	std::array<char, 12> buf {};
+	auto len = Formatter<formatStringMulti>::writeTo(buf, "one", "two");
+	BOOST_CHECK(!len);
+	BOOST_CHECK_EQUAL(std::string_view(buf.data(), buf.size()), "First one, t");
+}
+
+BOOST_AUTO_TEST_CASE(fixedBuffer)
+{
+	FixedBuffer<64> buf;
+	Formatter<formatStringMulti>::write(buf, "one", 2);
+	BOOST_CHECK(!buf.truncated());
+	BOOST_CHECK_EQUAL(buf.length(), 18);
+	BOOST_CHECK_EQUAL(buf.sv(), "First one, then 2.");
+}
+
+BOOST_AUTO_TEST_CASE(fixedBufferTruncated)
+{
+	FixedBuffer<8> buf;
+	Formatter<formatStringMulti>::write(buf, "one", 2);
+	BOOST_CHECK(buf.truncated());
+	BOOST_CHECK_EQUAL(buf.sv(), "First on");
+}
+
 #include "ctf-impl/printf-compat.h"
 
 static_assert(isdigit('0'));
@@ -327,11 +371,12 @@ GLIBC_FMT_TEST(s2, "in %s %s.", "string", "other")
 GLIBC_FMT_TEST(s3, "in %.*s.", 3, "other")
 GLIBC_FMT_TEST(s4, "in %.*s.", 5, "other")
 GLIBC_FMT_TEST(s5, "in %.*s.", 7, "other")
+GLIBC_FMT_TEST(s6, "in %-8.*s|%.*s.", 3, "other", -1, "whole")
 GLIBC_FMT_TEST(s35, "in %3s.", "other")
 GLIBC_FMT_TEST(s55, "in %5s.", "other")
 GLIBC_FMT_TEST(s115, "in %11s.", "other")
-// std::setw does not truncate strings
-// GLIBC_FMT_TEST(sd35, "in %.3s.", "other")
+GLIBC_FMT_TEST(sd35, "in %.3s.", "other")
+GLIBC_FMT_TEST(sdm35, "in %-8.3s.", "other")
 GLIBC_FMT_TEST(sd55, "in %.5s.", "other")
 GLIBC_FMT_TEST(sd115, "in %.11s.", "other")
 
@@ -348,6 +393,13 @@ GLIBC_FMT_TEST(d3, "in %hd.", static_cast<int16_t>(-12345))
 GLIBC_FMT_TEST(d4, "in %hhd.", static_cast<int8_t>(-123))
 GLIBC_FMT_TEST(d5, "in %ld.", -123456L)
 GLIBC_FMT_TEST(d6, "in %lld.", -123456LL)
+GLIBC_FMT_TEST(d7, "in %+d %+d.", 123, -123)
+GLIBC_FMT_TEST(d8, "in % d % d.", 123, -123)
+GLIBC_FMT_TEST(d9, "in %-6d|%6d|%06d.", -123, -123, -123)
+GLIBC_FMT_TEST(d10, "in %.5d %8.5d %.0d.", -123, 123, 0)
+GLIBC_FMT_TEST(d11, "in %lld %lld.", std::numeric_limits<long long>::min(), std::numeric_limits<long long>::max())
+GLIBC_FMT_TEST(d12, "in [%.*d]%d [%-8.*d]%d [%8.*d] %.*d.", 5, 42, 7, 3, -4, 1, 3, 9, -1, 12)
+GLIBC_FMT_TEST(u1, "in %u %lu.", 123U, std::numeric_limits<unsigned long>::max())
 GLIBC_FMT_TEST(i1, "in %i.", 123)
 GLIBC_FMT_TEST(i2, "in %i.", -123)
 
@@ -360,7 +412,10 @@ GLIBC_FMT_TEST(x6, "in %#x.", 123U)
 GLIBC_FMT_TEST(x7, "in %#X.", 123U)
 GLIBC_FMT_TEST(x8, "in %#X %x.", 123U, 150U)
 
+GLIBC_FMT_TEST(x9, "in %#x %#08x %-#8X|.", 0U, 255U, 255U)
+
 GLIBC_FMT_TEST(o1, "in %o.", 123U)
+GLIBC_FMT_TEST(o4, "in %#o %#o.", 0U, 8U)
 GLIBC_FMT_TEST(o2, "in %o %d.", 123U, 256)
 GLIBC_FMT_TEST(o3, "in %d %o.", 123, 1024U)
 
@@ -372,6 +427,10 @@ GLIBC_FMT_TEST(a5, "in %A.", -.123456789)
 GLIBC_FMT_TEST(a6, "in %A.", -123.456789)
 GLIBC_FMT_TEST(a7, "in %a.", 123456789.123)
 GLIBC_FMT_TEST(a8, "in %a.", -123456789.123)
+GLIBC_FMT_TEST(a9, "in %a %A %a %5A|.", std::numeric_limits<double>::quiet_NaN(),
+		std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(),
+		-std::numeric_limits<double>::infinity())
+GLIBC_FMT_TEST(a10, "in %#a %#.0a %#.0A.", 1.0, 1.0, 3.0)
 
 GLIBC_FMT_TEST(e1, "in %e.", 123.456789)
 GLIBC_FMT_TEST(e2, "in %e.", -123.456789)
@@ -381,6 +440,7 @@ GLIBC_FMT_TEST(e5, "in %E.", -.123456789)
 GLIBC_FMT_TEST(e6, "in %E.", -123.456789)
 GLIBC_FMT_TEST(e7, "in %e.", 123456789.123)
 GLIBC_FMT_TEST(e8, "in %e.", -123456789.123)
+GLIBC_FMT_TEST(e9, "in %#.0e %#.0E %#e %#.0e.", 1.0, -12.0, 1.0, std::numeric_limits<double>::infinity())
 
 GLIBC_FMT_TEST(f1, "in %f.", 123.456789)
 GLIBC_FMT_TEST(f2, "in %f.", -123.456789)
@@ -391,6 +451,15 @@ GLIBC_FMT_TEST(f6, "in %F.", -123.456789)
 GLIBC_FMT_TEST(f7, "in %f.", 123456789.123)
 GLIBC_FMT_TEST(f8, "in %f.", -123456789.123)
 
+GLIBC_FMT_TEST(f9, "in %+.2f % .0f %010.3f %-10.1f|.", 1.005, 2.5, -3.14159, 42.0)
+GLIBC_FMT_TEST(f10, "in %f %F %5f.", std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+		std::numeric_limits<double>::quiet_NaN())
+GLIBC_FMT_TEST(f11, "in %f.", std::numeric_limits<double>::max())
+GLIBC_FMT_TEST(f12, "in %Lf %Le.", 123.456789L, -123.456789L)
+GLIBC_FMT_TEST(f13, "in %#.0f %#.0f %#08.0f %#f %#.0f.", 1.0, -0.0, 42.0, 1.5, std::numeric_limits<double>::quiet_NaN())
+GLIBC_FMT_TEST(f14, "in [%.*f]%d [%10.*e] %.*g %#.*g %.*f.", 2, 3.14159, 7, 3, -0.000123, 10, 1.0 / 3, 4, 2.0, 400,
+		0.1)
+
 GLIBC_FMT_TEST(g1, "in %g.", 123.456789)
 GLIBC_FMT_TEST(g2, "in %g.", -123.456789)
 GLIBC_FMT_TEST(g3, "in %g.", .123456789)
@@ -399,6 +468,11 @@ GLIBC_FMT_TEST(g5, "in %G.", -.123456789)
 GLIBC_FMT_TEST(g6, "in %G.", -123.456789)
 GLIBC_FMT_TEST(g7, "in %g.", 123456789.123)
 GLIBC_FMT_TEST(g8, "in %g.", -123456789.123)
+GLIBC_FMT_TEST(g9, "in %.3g %.10g %g.", 0.0001234, 1e-5, 1e100)
+GLIBC_FMT_TEST(g10, "in %#g %#g %#g %#G %#.3g.", 1.0, 0.0, 0.0001234, 1e100, 100.0)
+GLIBC_FMT_TEST(g11, "in %#.0g %#.1g %#g %#g %#.10g.", 1.0, 20.0, -123.456789, 123456789.123, 0.5)
+
+GLIBC_FMT_TEST(c3, "in %3c|%-3c.", 'a', 'b')
 
 GLIBC_FMT_TEST(
 		fmtlibt_fmt, "%0.10f:%04d:%+g:%s:%p:%c:%%\n", 1.234, 42, 3.13, "str", reinterpret_cast<void *>(1000), 'X')
@@ -415,6 +489,82 @@ BOOST_AUTO_TEST_CASE(chars_written)
 }
 
 GLIBC_FMT_TEST(p2, "in %p.", static_cast<void *>(this))
+GLIBC_FMT_TEST(p3, "in %p.", static_cast<void *>(nullptr))
+
+AdHocFormatter(filestar_printf_fmt, "%s %05d %x %.2f");
+BOOST_AUTO_TEST_CASE(filestar_printf)
+{
+	MemStream strm;
+	// NOLINTNEXTLINE(misc-non-copyable-objects)
+	filestar_printf_fmt::write(*strm.operator FILE *(), "file", 42, 255U, 1.5);
+	BOOST_CHECK_EQUAL(strm.sv(), "file 00042 ff 1.50");
+}
+
+AdHocFormatter(stream_state_fmt, "%05d %x %? %?");
+BOOST_AUTO_TEST_CASE(stream_state_untouched)
+{
+	std::stringstream str;
+	stream_state_fmt::write(str, 1, 255U, 2, 3.0);
+	BOOST_CHECK_EQUAL(str.str(), "00001 ff 2 3");
+	BOOST_CHECK_EQUAL(str.fill(), ' ');
+	BOOST_CHECK_EQUAL(str.flags(), std::ios_base::skipws | std::ios_base::dec);
+}
+
+static_assert(!LiteralFormatter<"%?">::maxLength<int>());
+static_assert(!LiteralFormatter<"%s">::maxLength<const char *>());
+static_assert(!LiteralFormatter<"%d">::maxLength<>());
+static_assert(LiteralFormatter<"literal">::maxLength<>() == 7);
+static_assert(LiteralFormatter<"%%">::maxLength<>() == 1);
+static_assert(LiteralFormatter<"%.3s">::maxLength<const char *>() == 3);
+static_assert(LiteralFormatter<"%10.3s">::maxLength<const char *>() == 10);
+static_assert(LiteralFormatter<"%c">::maxLength<char>() == 1);
+static_assert(LiteralFormatter<"[%d]">::maxLength<int>() >= 13);
+static_assert(LiteralFormatter<"%40d">::maxLength<int>() == 40);
+static_assert(LiteralFormatter<"%hhu">::maxLength<unsigned char>() >= 3);
+static_assert(LiteralFormatter<"%x">::maxLength<unsigned int>() >= 10);
+static_assert(LiteralFormatter<"%f">::maxLength<double>() >= 317);
+static_assert(LiteralFormatter<"%n%d">::maxLength<std::streamoff *, int>()
+		== LiteralFormatter<"%d">::maxLength<int>());
+
+AdHocFormatter(max_length_fmt, "%s: %d/%u %#x %.3f %e %g %a %p %c %n%%.");
+BOOST_AUTO_TEST_CASE(max_length_bounds)
+{
+	constexpr auto max = max_length_fmt::maxLength<const char *, int, unsigned int, unsigned int, double, double, double,
+			double, void *, char, std::streamoff *>();
+	static_assert(!max);
+	constexpr auto maxPrec = LiteralFormatter<"%.10s: %d/%u %#x %.3f %e %g %a %p %c %n%%.">::maxLength<const char *,
+			int, unsigned int, unsigned int, double, double, double, double, void *, char, std::streamoff *>();
+	static_assert(maxPrec);
+	FixedBuffer<*maxPrec> buf;
+	std::streamoff n {};
+	LiteralFormatter<"%.10s: %d/%u %#x %.3f %e %g %a %p %c %n%%.">::write(buf, "a long string value",
+			std::numeric_limits<int>::min(), std::numeric_limits<unsigned int>::max(),
+			std::numeric_limits<unsigned int>::max(), -std::numeric_limits<double>::max(),
+			-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+			-std::numeric_limits<double>::max(), &n, 'x', &n);
+	BOOST_CHECK(!buf.truncated());
+}
+
+AdHocFormatter(fixed_buffer_printf_fmt, "%n%s %05d %#x %.3f%n");
+BOOST_AUTO_TEST_CASE(fixed_buffer_printf)
+{
+	std::streamoff a = -1, b = -1;
+	FixedBuffer<64> buf;
+	fixed_buffer_printf_fmt::write(buf, &a, "str", 42, 255U, 3.14159, &b);
+	BOOST_CHECK_EQUAL(buf.sv(), "str 00042 0xff 3.142");
+	BOOST_CHECK_EQUAL(a, 0);
+	BOOST_CHECK_EQUAL(b, buf.length());
+}
+
+BOOST_AUTO_TEST_CASE(fixed_buffer_printf_writeto)
+{
+	std::array<char, 64> buf {};
+	std::streamoff a = -1, b = -1;
+	auto len = fixed_buffer_printf_fmt::writeTo(buf, &a, "str", 42, 255U, 3.14159, &b);
+	BOOST_REQUIRE(len);
+	BOOST_CHECK_EQUAL(std::string_view(buf.data(), *len), "str 00042 0xff 3.142");
+	BOOST_CHECK_EQUAL(b, *len);
+}
 
 AdHocFormatter(smartptr_fmt, "Address is %p.");
 BOOST_AUTO_TEST_CASE(smartptr)
@@ -1,21 +1,46 @@
 #define BOOST_TEST_MODULE Curl
 #include <boost/test/unit_test.hpp>
 
+#include "buffer.h"
 #include "compileTimeFormatter.h"
+#include "curlClient.h"
+#include "curlDecoding.h"
 #include "curlHandle.h"
+#include "curlHandlePool.h"
 #include "curlMultiHandle.h"
 #include "curlStream.h"
+#include "curlTimings.h"
 #include "definedDirs.h"
+#include "fileUtils.h"
+#include "httpTestServer.h"
+#include <algorithm>
+#include <array>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/core/typeinfo.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <chrono>
+#include <coroutine>
+#include <cstring>
 #include <cstddef>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <future>
+#include <limits>
 #include <map>
+#include <sstream>
+#include <stdexcept>
 #include <net.h> // IWYU pragma: keep
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 using namespace AdHoc::Net;
 
@@ -169,3 +194,809 @@ BOOST_AUTO_TEST_CASE(fetch_multi_fail)
 	BOOST_REQUIRE(!finished);
 	BOOST_REQUIRE(errored);
 }
+
+BOOST_AUTO_TEST_CASE(fetch_multi_http)
+{
+	HttpTestServer server {4096};
+	CurlMultiHandle cmh;
+	size_t fetched = 0, bytes = 0;
+	for (int i = 0; i < 50; ++i) {
+		cmh.addCurl(server.url("/" + std::to_string(i)), [&fetched, &bytes](std::istream & s) {
+			s.ignore(std::numeric_limits<std::streamsize>::max());
+			bytes += static_cast<size_t>(s.gcount());
+			fetched += 1;
+		});
+	}
+	cmh.performAll();
+	BOOST_CHECK_EQUAL(50, fetched);
+	BOOST_CHECK_EQUAL(50 * 4096, bytes);
+}
+
+static size_t
+fetchAll(CurlMultiHandle & cmh, const HttpTestServer & server, size_t count)
+{
+	size_t fetched = 0;
+	for (size_t i = 0; i < count; ++i) {
+		cmh.addCurl(server.url(), [&fetched](std::istream & s) {
+			s.ignore(std::numeric_limits<std::streamsize>::max());
+			fetched += 1;
+		});
+	}
+	cmh.performAll();
+	return fetched;
+}
+
+BOOST_AUTO_TEST_CASE(fetch_multi_serial)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 1}};
+	BOOST_CHECK_EQUAL(20, fetchAll(cmh, server, 20));
+	// One at a time, over one kept alive connection
+	BOOST_CHECK_EQUAL(1, server.peakConnections());
+}
+
+BOOST_AUTO_TEST_CASE(fetch_multi_host_limit)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 20, .hostConnections = 2}};
+	BOOST_CHECK_EQUAL(40, fetchAll(cmh, server, 40));
+	BOOST_CHECK_LE(server.peakConnections(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(fetch_multi_wide)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	cmh.limits.transfers = 50;
+	BOOST_CHECK_EQUAL(200, fetchAll(cmh, server, 200));
+	BOOST_CHECK_GT(server.peakConnections(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(fetch_multi_adaptive)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 100, .adaptive = true, .minTransfers = 2}};
+	BOOST_CHECK_EQUAL(1000, fetchAll(cmh, server, 1000));
+	BOOST_CHECK_LE(server.peakConnections(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(fresh_handles_reconnect)
+{
+	HttpTestServer server;
+	for (int i = 0; i < 5; ++i) {
+		CurlHandle ch {server.url()};
+		ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+		ch.perform();
+	}
+	BOOST_CHECK_EQUAL(5, server.acceptedConnections());
+}
+
+BOOST_AUTO_TEST_CASE(pooled_handles_reuse_connection)
+{
+	HttpTestServer server;
+	CurlHandlePool pool {2, 2};
+	for (int i = 0; i < 5; ++i) {
+		auto ch = pool.get(server.url("/" + std::to_string(i)));
+		ch->setopt(CURLOPT_WRITEFUNCTION, discard);
+		ch->perform();
+		char * eurl;
+		ch->getinfo(CURLINFO_EFFECTIVE_URL, eurl);
+		BOOST_CHECK_EQUAL(server.url("/" + std::to_string(i)), eurl);
+	}
+	BOOST_CHECK_EQUAL(1, pool.availableCount());
+	BOOST_CHECK_EQUAL(1, server.acceptedConnections());
+}
+
+BOOST_AUTO_TEST_CASE(pooled_handles_reset)
+{
+	CurlHandlePool pool {1, 1};
+	{
+		auto ch = pool.get(urlGen("nothere"));
+		ch->appendHeader("X-Test: 1");
+		BOOST_CHECK_THROW(ch->perform(), AdHoc::Net::CurlException);
+	}
+	auto ch = pool.get(urlGen("testCurl.cpp"));
+	ch->setopt(CURLOPT_WRITEFUNCTION, discard);
+	BOOST_CHECK_NO_THROW(ch->perform());
+}
+
+BOOST_AUTO_TEST_CASE(shared_handles_reuse_connection)
+{
+	HttpTestServer server;
+	auto share = std::make_shared<CurlShare>();
+	for (int i = 0; i < 5; ++i) {
+		CurlHandle ch {server.url()};
+		ch.setShare(share);
+		ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+		ch.perform();
+	}
+	BOOST_CHECK_EQUAL(1, server.acceptedConnections());
+}
+
+BOOST_AUTO_TEST_CASE(shared_multi_reuse_connection)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 1}};
+	cmh.share = std::make_shared<CurlShare>();
+	BOOST_CHECK_EQUAL(5, fetchAll(cmh, server, 5));
+	BOOST_CHECK_EQUAL(5, fetchAll(cmh, server, 5));
+	BOOST_CHECK_EQUAL(1, server.acceptedConnections());
+}
+
+BOOST_AUTO_TEST_CASE(fetch_http_stream_large)
+{
+	// Much larger than the buffer, read in small pieces, so the transfer pauses for backpressure
+	HttpTestServer server {4 << 20};
+	CurlStreamSource css {server.url()};
+	CurlStream curlstrm {css};
+	std::array<char, 1000> buf {};
+	size_t bytes = 0;
+	while (curlstrm.read(buf.data(), buf.size()), curlstrm.gcount() > 0) {
+		BOOST_REQUIRE_EQUAL('x', buf.front());
+		bytes += static_cast<size_t>(curlstrm.gcount());
+	}
+	BOOST_CHECK_EQUAL(4 << 20, bytes);
+}
+
+BOOST_AUTO_TEST_CASE(fetch_http_stream_big_writes)
+{
+	// Writes larger than the buffer's default capacity
+	HttpTestServer server {4 << 20};
+	CurlStreamSource css {server.url()};
+	css.setopt(CURLOPT_BUFFERSIZE, 512L << 10);
+	CurlStream curlstrm {css};
+	curlstrm.ignore(std::numeric_limits<std::streamsize>::max());
+	BOOST_CHECK_EQUAL(4 << 20, curlstrm.gcount());
+}
+
+BOOST_AUTO_TEST_CASE(fetch_file_stream_large)
+{
+	// libcurl can't pause file:// transfers, so these take the alternate stack route
+	const auto path = binDir / "large.file";
+	std::ofstream {path} << std::string(1 << 20, 'x');
+	CurlStreamSource css {"file://" + path.string()};
+	CurlStream curlstrm {css};
+	std::array<char, 1000> buf {};
+	size_t bytes = 0;
+	while (curlstrm.read(buf.data(), buf.size()), curlstrm.gcount() > 0) {
+		BOOST_REQUIRE_EQUAL('x', buf.front());
+		bytes += static_cast<size_t>(curlstrm.gcount());
+	}
+	BOOST_CHECK_EQUAL(1 << 20, bytes);
+	std::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(fetch_multi_large)
+{
+	HttpTestServer server {4 << 20};
+	CurlMultiHandle cmh;
+	std::vector<size_t> sizes;
+	for (int i = 0; i < 4; ++i) {
+		cmh.addCurl(server.url(), [&sizes](std::istream & s) {
+			s.ignore(std::numeric_limits<std::streamsize>::max());
+			sizes.push_back(static_cast<size_t>(s.gcount()));
+		});
+	}
+	cmh.performAll();
+	BOOST_CHECK_EQUAL(4, sizes.size());
+	BOOST_CHECK(std::all_of(sizes.begin(), sizes.end(), [](auto s) {
+		return s == 4 << 20;
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(client_future)
+{
+	HttpTestServer server;
+	CurlClient client;
+	auto response = client.fetch(server.url()).get();
+	BOOST_CHECK_EQUAL(200, response.status);
+	BOOST_CHECK_EQUAL(1024, response.body.length());
+	BOOST_REQUIRE_EQUAL(1, response.headers.count("content-length"));
+	BOOST_CHECK_EQUAL("1024", response.headers.find("Content-Length")->second);
+}
+
+BOOST_AUTO_TEST_CASE(client_reuse)
+{
+	HttpTestServer server;
+	CurlClient client;
+	auto handle = std::make_shared<CurlHandle>(server.url());
+	BOOST_CHECK_EQUAL(200, client.fetch(handle).get().status);
+	// The client's callbacks are gone, leaving the handle usable as it was
+	handle->setopt(CURLOPT_WRITEFUNCTION, +[](void * data, size_t sz, size_t nm, void * stream) {
+		BOOST_CHECK(data);
+		BOOST_CHECK(stream == stdout);
+		return sz * nm;
+	});
+	BOOST_CHECK_NO_THROW(handle->perform());
+	BOOST_CHECK_EQUAL(1024, client.fetch(handle).get().body.length());
+}
+
+BOOST_AUTO_TEST_CASE(client_fail)
+{
+	CurlClient client;
+	auto response = client.fetch(urlGen("nothere"));
+	BOOST_CHECK_THROW(response.get(), AdHoc::Net::CurlException);
+}
+
+BOOST_AUTO_TEST_CASE(client_threads)
+{
+	HttpTestServer server;
+	CurlClient client {{.transfers = 4}};
+	std::vector<std::thread> threads;
+	std::array<size_t, 4> bytes {};
+	for (auto & b : bytes) {
+		threads.emplace_back([&client, &server, &b]() {
+			std::vector<std::future<CurlResponse>> responses;
+			for (int i = 0; i < 25; ++i) {
+				responses.push_back(client.fetch(server.url()));
+			}
+			for (auto & r : responses) {
+				b += r.get().body.length();
+			}
+		});
+	}
+	for (auto & t : threads) {
+		t.join();
+	}
+	BOOST_CHECK(std::all_of(bytes.begin(), bytes.end(), [](auto b) {
+		return b == 25 * 1024;
+	}));
+	BOOST_CHECK_LE(server.acceptedConnections(), 4);
+}
+
+namespace {
+	/// Minimal coroutine type which runs to completion without being awaited.
+	struct Detached {
+		struct promise_type {
+			Detached
+			get_return_object()
+			{
+				return {};
+			}
+
+			std::suspend_never
+			initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never
+			final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void
+			return_void()
+			{
+			}
+
+			void
+			unhandled_exception()
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	Detached
+	fetchSequence(CurlClient & client, std::string url, std::promise<size_t> & done)
+	{
+		size_t bytes = 0;
+		for (int i = 0; i < 10; ++i) {
+			bytes += (co_await client.fetchAsync(url)).body.length();
+		}
+		try {
+			co_await client.fetchAsync(urlGen("nothere"));
+		}
+		catch (const AdHoc::Net::CurlException &) {
+			done.set_value(bytes);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(client_coroutine)
+{
+	HttpTestServer server;
+	CurlClient client;
+	std::promise<size_t> done;
+	fetchSequence(client, server.url(), done);
+	BOOST_CHECK_EQUAL(10 * 1024, done.get_future().get());
+}
+
+BOOST_AUTO_TEST_CASE(client_abandon)
+{
+	HttpTestServer server {4 << 20};
+	std::vector<std::future<CurlResponse>> responses;
+	{
+		CurlClient client {{.transfers = 1}};
+		for (int i = 0; i < 10; ++i) {
+			responses.push_back(client.fetch(server.url()));
+		}
+	}
+	// Everything completes, one way or another, by the time the client is gone
+	BOOST_CHECK(std::all_of(responses.begin(), responses.end(), [](auto & r) {
+		return r.wait_for(std::chrono::seconds {0}) == std::future_status::ready;
+	}));
+	BOOST_CHECK_THROW(responses.back().get(), AdHoc::Net::CurlException);
+}
+
+BOOST_AUTO_TEST_CASE(upload_stream)
+{
+	HttpTestServer server;
+	std::stringstream body {std::string(100000, 'y')};
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.setBody(body, 100000);
+	ch.perform();
+	BOOST_CHECK_EQUAL(100000, server.uploadedBytes());
+	BOOST_CHECK_EQUAL("POST", server.lastMethod());
+}
+
+BOOST_AUTO_TEST_CASE(upload_stream_chunked)
+{
+	HttpTestServer server;
+	std::stringstream body {std::string(100000, 'y')};
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.setBody(body);
+	ch.perform();
+	BOOST_CHECK_EQUAL(100000, server.uploadedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(upload_buffer)
+{
+	HttpTestServer server;
+	AdHoc::Buffer body;
+	body.append(std::string(40000, 'y')).append("some more").appendf(" and %d", 1);
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.setBody(body);
+	ch.perform();
+	BOOST_CHECK_EQUAL(body.length(), server.uploadedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(upload_file_put)
+{
+	// Large enough for libcurl to expect 100-continue
+	const auto path = binDir / "upload.file";
+	std::ofstream {path} << std::string(2 << 20, 'y');
+	HttpTestServer server;
+	AdHoc::FileUtils::FileHandle fh {path};
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.setBody(fh, -1, CurlHandle::BodyMethod::Put);
+	ch.perform();
+	BOOST_CHECK_EQUAL(2 << 20, server.uploadedBytes());
+	BOOST_CHECK_EQUAL("PUT", server.lastMethod());
+	std::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(upload_fail)
+{
+	HttpTestServer server;
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.setBody([](char *, size_t) -> size_t {
+		throw std::runtime_error("no body");
+	});
+	BOOST_CHECK_THROW(ch.perform(), AdHoc::Net::CurlException);
+}
+
+BOOST_AUTO_TEST_CASE(post_parts)
+{
+	HttpTestServer server;
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.appendPost("name", "value");
+	size_t remaining = 50000;
+	ch.appendPost(
+			"generated",
+			[&remaining](char * buf, size_t len) {
+				len = std::min(len, remaining);
+				memset(buf, 'y', len);
+				remaining -= len;
+				return len;
+			},
+			50000);
+	ch.appendPostFile("file", rootDir / "testCurl.cpp");
+	ch.perform();
+	BOOST_CHECK_EQUAL(0, remaining);
+	BOOST_CHECK_GT(server.uploadedBytes(), 50000 + std::filesystem::file_size(rootDir / "testCurl.cpp"));
+}
+
+BOOST_AUTO_TEST_CASE(histogram)
+{
+	using namespace std::chrono_literals;
+	CurlHistogram h;
+	BOOST_CHECK_EQUAL(0, h.count());
+	BOOST_CHECK_EQUAL(0, h.percentile(50).count());
+	for (const auto us : {0us, 1us, 3us, 1000us, 1000us, 1000000us}) {
+		h.add(us);
+	}
+	BOOST_CHECK_EQUAL(6, h.count());
+	BOOST_CHECK_EQUAL(0, h.min().count());
+	BOOST_CHECK_EQUAL(1000000, h.max().count());
+	BOOST_CHECK_EQUAL(167000, h.mean().count());
+	BOOST_CHECK_EQUAL(1, h.buckets()[0]);
+	BOOST_CHECK_EQUAL(1, h.buckets()[1]);
+	BOOST_CHECK_EQUAL(1, h.buckets()[2]);
+	BOOST_CHECK_EQUAL(2, h.buckets()[10]);
+	BOOST_CHECK_EQUAL(1, h.buckets()[20]);
+	BOOST_CHECK_EQUAL(1024, CurlHistogram::bucketLimit(10).count());
+	BOOST_CHECK_EQUAL(1, h.percentile(0).count());
+	BOOST_CHECK_EQUAL(4, h.percentile(50).count());
+	BOOST_CHECK_EQUAL(1024, h.percentile(80).count());
+	BOOST_CHECK_EQUAL(1000000, h.percentile(100).count());
+}
+
+BOOST_AUTO_TEST_CASE(timing)
+{
+	HttpTestServer server;
+	CurlHandle ch {server.url()};
+	ch.setopt(CURLOPT_WRITEFUNCTION, discard);
+	ch.perform();
+	const auto t = ch.timing();
+	BOOST_CHECK_EQUAL(1024, t.downloaded);
+	BOOST_CHECK_EQUAL(0, t.appConnect.count());
+	BOOST_CHECK_LE(t.nameLookup, t.connect);
+	BOOST_CHECK_LE(t.connect, t.preTransfer);
+	BOOST_CHECK_LE(t.preTransfer, t.startTransfer);
+	BOOST_CHECK_LE(t.startTransfer, t.total);
+	BOOST_CHECK_GT(t.total.count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(multi_timings)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 2}};
+	cmh.timings = std::make_shared<CurlTimings>();
+	size_t observed = 0;
+	cmh.timings->observer = [&observed](const std::string &, const CurlTiming &, CURLcode) {
+		observed += 1;
+	};
+	BOOST_CHECK_EQUAL(10, fetchAll(cmh, server, 10));
+	cmh.addCurl(urlGen("nothere"), [](std::istream &) {});
+	cmh.performAll();
+	BOOST_CHECK_EQUAL(11, observed);
+
+	const auto hosts = cmh.timings->hosts();
+	BOOST_REQUIRE_EQUAL(2, hosts.size());
+	const auto & local = hosts.at("127.0.0.1:" + std::to_string(server.port()));
+	BOOST_CHECK_EQUAL(10, local.transfers);
+	BOOST_CHECK_EQUAL(0, local.failures);
+	BOOST_CHECK_EQUAL(10 * 1024, local.downloaded);
+	BOOST_CHECK_EQUAL(10, local.total.count());
+	BOOST_CHECK_EQUAL(10, local.wait.count());
+	BOOST_CHECK_EQUAL(0, local.tls.count());
+	const auto & file = hosts.at("");
+	BOOST_CHECK_EQUAL(1, file.transfers);
+	BOOST_CHECK_EQUAL(1, file.failures);
+
+	size_t exported = 0;
+	cmh.timings->exportTo(
+			[&exported](const std::string &, const CurlHostTimings & t) {
+				exported += t.transfers;
+			},
+			true);
+	BOOST_CHECK_EQUAL(11, exported);
+	BOOST_CHECK(cmh.timings->hosts().empty());
+}
+
+BOOST_AUTO_TEST_CASE(client_timings)
+{
+	HttpTestServer server;
+	auto timings = std::make_shared<CurlTimings>();
+	CurlClient client {{}, timings};
+	client.fetch(server.url()).get();
+	client.fetch(server.url()).get();
+	const auto hosts = timings->hosts();
+	BOOST_REQUIRE_EQUAL(1, hosts.size());
+	BOOST_CHECK_EQUAL(2, hosts.begin()->second.transfers);
+}
+
+/// Fetch each of the given URLs, returning the bytes received by each, or -1 for those that failed.
+static std::vector<std::streamsize>
+fetchEach(CurlMultiHandle & cmh, const std::vector<std::string> & urls)
+{
+	std::vector<std::streamsize> received(urls.size());
+	for (size_t i = 0; i < urls.size(); ++i) {
+		cmh.addCurl(urls[i], [&r = received[i]](std::istream & s) {
+			s.ignore(std::numeric_limits<std::streamsize>::max());
+			r = s.bad() ? -1 : s.gcount();
+		});
+	}
+	cmh.performAll();
+	return received;
+}
+
+BOOST_AUTO_TEST_CASE(retry_transient)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	cmh.retry = {.attempts = 3, .backoff = std::chrono::milliseconds {1}};
+	server.failNext(2);
+	BOOST_CHECK_EQUAL(1024, fetchEach(cmh, {server.url()}).front());
+	server.failNext(1, 429);
+	BOOST_CHECK_EQUAL(1024, fetchEach(cmh, {server.url()}).front());
+}
+
+BOOST_AUTO_TEST_CASE(retry_exhausted)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	cmh.retry = {.attempts = 3, .backoff = std::chrono::milliseconds {1}};
+	server.failNext(3);
+	BOOST_CHECK_EQUAL(-1, fetchEach(cmh, {server.url()}).front());
+	BOOST_CHECK_EQUAL(1024, fetchEach(cmh, {server.url()}).front());
+}
+
+BOOST_AUTO_TEST_CASE(retry_none)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	// By default
+	server.failNext(1);
+	BOOST_CHECK_EQUAL(-1, fetchEach(cmh, {server.url()}).front());
+	// Not a retryable status
+	cmh.retry.attempts = 3;
+	server.failNext(1, 404);
+	BOOST_CHECK_EQUAL(-1, fetchEach(cmh, {server.url()}).front());
+	// Not a safe method
+	server.failNext(1);
+	cmh.addCurl(server.url(), [](std::istream & s) {
+		s.ignore(std::numeric_limits<std::streamsize>::max());
+		BOOST_CHECK(s.bad());
+	})->setopt(CURLOPT_COPYPOSTFIELDS, "posted");
+	cmh.performAll();
+	BOOST_CHECK_EQUAL(6, server.uploadedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(retry_many)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 10}};
+	// Enough attempts that even a transfer which gets every failure eventually succeeds
+	cmh.retry = {.attempts = 11, .backoff = std::chrono::milliseconds {1}, .maxBackoff = std::chrono::milliseconds {10}};
+	server.failNext(10);
+	const auto received = fetchEach(cmh, std::vector<std::string>(50, server.url()));
+	BOOST_CHECK(std::all_of(received.begin(), received.end(), [](auto r) {
+		return r == 1024;
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(hedge_slow)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	cmh.hedging = {.percentile = 95, .initialDelay = std::chrono::milliseconds {50}};
+	server.delayNext(1, std::chrono::seconds {5});
+	const auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK_EQUAL(1024, fetchEach(cmh, {server.url()}).front());
+	// The hedge responded, long before the original would have
+	BOOST_CHECK_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds {2});
+	BOOST_CHECK_EQUAL(2, server.acceptedConnections());
+}
+
+BOOST_AUTO_TEST_CASE(hedge_unneeded)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh {{.transfers = 1}};
+	cmh.hedging = {.percentile = 95, .initialDelay = std::chrono::seconds {5}};
+	cmh.timings = std::make_shared<CurlTimings>();
+	const auto received = fetchEach(cmh, std::vector<std::string>(20, server.url()));
+	BOOST_CHECK(std::all_of(received.begin(), received.end(), [](auto r) {
+		return r == 1024;
+	}));
+	BOOST_CHECK_EQUAL(1, server.acceptedConnections());
+	BOOST_CHECK_EQUAL(20, cmh.timings->hosts().begin()->second.transfers);
+}
+
+BOOST_AUTO_TEST_CASE(hedge_post)
+{
+	HttpTestServer server;
+	CurlMultiHandle cmh;
+	cmh.hedging = {.percentile = 95, .initialDelay = std::chrono::milliseconds {10}};
+	server.delayNext(1, std::chrono::milliseconds {200});
+	cmh.addCurl(server.url(), [](std::istream & s) {
+		s.ignore(std::numeric_limits<std::streamsize>::max());
+		BOOST_CHECK_EQUAL(1024, s.gcount());
+	})->setopt(CURLOPT_COPYPOSTFIELDS, "posted");
+	cmh.performAll();
+	// Never duplicated
+	BOOST_CHECK_EQUAL(1, server.acceptedConnections());
+	BOOST_CHECK_EQUAL(6, server.uploadedBytes());
+}
+
+BOOST_AUTO_TEST_CASE(content_encodings)
+{
+	BOOST_CHECK(ContentEncoding::Identity == contentEncoding(""));
+	BOOST_CHECK(ContentEncoding::Identity == contentEncoding("identity"));
+	BOOST_CHECK(ContentEncoding::Gzip == contentEncoding("GZip"));
+	BOOST_CHECK(ContentEncoding::Gzip == contentEncoding("x-gzip"));
+	BOOST_CHECK(ContentEncoding::Deflate == contentEncoding("deflate"));
+	BOOST_CHECK(ContentEncoding::Zstd == contentEncoding("zstd"));
+	BOOST_CHECK_THROW(contentEncoding("br"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(record_reader)
+{
+	const std::string content {"one\n\nthree, which is longer than the buffer\nfour"};
+	std::string_view remaining {content};
+	// A tiny buffer and reads, so records span reads and outgrow the buffer
+	CurlRecordReader records {[&remaining](char * target, std::streamsize size) {
+								  const auto n = std::min<size_t>({remaining.length(), static_cast<size_t>(size), 3});
+								  remaining.copy(target, n);
+								  remaining.remove_prefix(n);
+								  return static_cast<std::streamsize>(n);
+							  },
+			'\n', 8};
+	BOOST_CHECK_EQUAL("one", records.next().value());
+	BOOST_CHECK_EQUAL("", records.next().value());
+	BOOST_CHECK_EQUAL("three, which is longer than the buffer", records.next().value());
+	BOOST_CHECK_EQUAL("four", records.next().value());
+	BOOST_CHECK(!records.next());
+	BOOST_CHECK(!records.next());
+}
+
+BOOST_AUTO_TEST_CASE(record_reader_files)
+{
+	CurlStreamSource css {urlGen("lorem-ipsum.txt")};
+	CurlRecordReader records {css};
+	std::ifstream expected {rootDir / "lorem-ipsum.txt"};
+	std::string line;
+	size_t count = 0;
+	while (std::getline(expected, line)) {
+		BOOST_REQUIRE_EQUAL(line, records.next().value());
+		count += 1;
+	}
+	BOOST_CHECK(!records.next());
+	BOOST_CHECK_EQUAL(9, count);
+}
+
+BOOST_AUTO_TEST_CASE(record_reader_fail)
+{
+	CurlStreamSource css {urlGen("nothere")};
+	CurlStream curlstrm {css};
+	CurlRecordReader records {curlstrm};
+	BOOST_CHECK_THROW(records.next(), AdHoc::Net::CurlException);
+	// The stream's own exception mask is left alone
+	BOOST_CHECK_EQUAL(std::ios_base::goodbit, curlstrm.exceptions());
+}
+
+namespace {
+	/// Many numbered records, for checking they all arrive intact and in order
+	std::string
+	numberedRecords(size_t count)
+	{
+		std::string content;
+		for (size_t i = 0; i < count; ++i) {
+			content.append("record ").append(std::to_string(i)).append(" of the compressed fixture\n");
+		}
+		return content;
+	}
+
+	template<typename Compressor>
+	std::string
+	compress(const std::string & content)
+	{
+		std::string compressed;
+		{
+			boost::iostreams::filtering_ostream out;
+			out.push(Compressor {});
+			out.push(boost::iostreams::back_inserter(compressed));
+			out << content;
+		}
+		return compressed;
+	}
+
+	template<typename Compressor>
+	std::filesystem::path
+	compressedFixture(const std::string & name, const std::string & content)
+	{
+		const auto path = binDir / name;
+		std::ofstream {path} << compress<Compressor>(content);
+		return path;
+	}
+
+	void
+	checkNumberedRecords(CurlRecordReader & records, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			BOOST_REQUIRE_EQUAL("record " + std::to_string(i) + " of the compressed fixture", records.next().value());
+		}
+		BOOST_CHECK(!records.next());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(decode_file_stream)
+{
+	constexpr size_t COUNT = 100000;
+	const auto content = numberedRecords(COUNT);
+	for (const auto & [path, encoding] : {
+				 std::make_pair(compressedFixture<boost::iostreams::gzip_compressor>("records.gz", content),
+						 ContentEncoding::Gzip),
+				 std::make_pair(compressedFixture<boost::iostreams::zlib_compressor>("records.zz", content),
+						 ContentEncoding::Deflate),
+				 std::make_pair(compressedFixture<boost::iostreams::zstd_compressor>("records.zst", content),
+						 ContentEncoding::Zstd),
+		 }) {
+		BOOST_TEST_CONTEXT(path) {
+			CurlStreamSource css {"file://" + path.string()};
+			CurlDecodingStream decoded {css, encoding};
+			CurlRecordReader records {decoded};
+			checkNumberedRecords(records, COUNT);
+		}
+		std::filesystem::remove(path);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(decode_multi)
+{
+	constexpr size_t COUNT = 10000;
+	const auto path = compressedFixture<boost::iostreams::gzip_compressor>("records.gz", numberedRecords(COUNT));
+	CurlMultiHandle cmh;
+	size_t consumed = 0;
+	for (int i = 0; i < 5; ++i) {
+		cmh.addCurl("file://" + path.string(), [&consumed](std::istream & s) {
+			CurlDecodingStream decoded {s, ContentEncoding::Gzip};
+			CurlRecordReader records {decoded};
+			checkNumberedRecords(records, COUNT);
+			consumed += 1;
+		});
+	}
+	cmh.performAll();
+	BOOST_CHECK_EQUAL(5, consumed);
+	std::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(decode_accept_encoding)
+{
+	constexpr size_t COUNT = 10000;
+	HttpTestServer server {compress<boost::iostreams::gzip_compressor>(numberedRecords(COUNT)), "gzip"};
+	// Decoded by libcurl, as the server declares the encoding; records are read straight from the source
+	CurlStreamSource css {server.url()};
+	css.setopt(CURLOPT_ACCEPT_ENCODING, "");
+	CurlRecordReader records {css};
+	checkNumberedRecords(records, COUNT);
+}
+
+BOOST_AUTO_TEST_CASE(server_chunked)
+{
+	HttpTestServer server {100000, {.chunkSize = 999}};
+	CurlStreamSource css {server.url()};
+	CurlStream curlstrm {css};
+	curlstrm.ignore(std::numeric_limits<std::streamsize>::max());
+	BOOST_CHECK_EQUAL(100000, curlstrm.gcount());
+	CurlMultiHandle cmh;
+	const auto received = fetchEach(cmh, std::vector<std::string>(10, server.url()));
+	BOOST_CHECK(std::all_of(received.begin(), received.end(), [](auto r) {
+		return r == 100000;
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(server_latency)
+{
+	HttpTestServer server {1024, {.latency = std::chrono::milliseconds {20}}};
+	CurlMultiHandle cmh {{.transfers = 1}};
+	const auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK_EQUAL(2, fetchEach(cmh, {server.url(), server.url()}).size());
+	BOOST_CHECK_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds {40});
+}
+
+BOOST_AUTO_TEST_CASE(server_error_rate)
+{
+	HttpTestServer server {1024, {.errorRate = 0.5}};
+	CurlMultiHandle cmh {{.transfers = 10}};
+	auto received = fetchEach(cmh, std::vector<std::string>(100, server.url()));
+	BOOST_CHECK_EQUAL(100, server.requests());
+	BOOST_CHECK_GT(server.errors(), 0);
+	BOOST_CHECK_LT(server.errors(), 100);
+	BOOST_CHECK_EQUAL(server.errors(), std::count(received.begin(), received.end(), -1));
+
+	// Retried until they succeed
+	cmh.retry = {.attempts = 30, .backoff = std::chrono::milliseconds {1}, .maxBackoff = std::chrono::milliseconds {2}};
+	received = fetchEach(cmh, std::vector<std::string>(100, server.url()));
+	BOOST_CHECK_EQUAL(100, std::count(received.begin(), received.end(), 1024));
+	BOOST_CHECK_GT(server.requests(), 200);
+}
@@ -1,12 +1,22 @@
 #define BOOST_TEST_MODULE Lexer
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <lexer-regex.h>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #pragma GCC diagnostic ignored "-Wsign-conversion"
@@ -105,3 +115,405 @@ BOOST_AUTO_TEST_CASE(badre)
 {
 	BOOST_REQUIRE_THROW(regex("["), std::runtime_error);
 }
+
+static void
+tokenRules(AdHoc::Lexer & l, std::vector<std::string> & tokens)
+{
+	l.rules = {{{AdHoc::Lexer::InitialState}, regex("if|else"),
+					   [&](auto es) {
+						   tokens.push_back("kw:" + std::string(*es->pattern()->match(0)));
+					   }},
+			{{AdHoc::Lexer::InitialState}, regex("([a-z]+)([0-9]*)"),
+					[&](auto es) {
+						BOOST_REQUIRE(!es->pattern()->match(3));
+						tokens.push_back(
+								"id:" + std::string(*es->pattern()->match(1)) + "/" + std::string(*es->pattern()->match(2)));
+					}},
+			{{AdHoc::Lexer::InitialState}, regex("(['\"])(.*?)\\1"),
+					[&](auto es) {
+						tokens.push_back("str:" + std::string(*es->pattern()->match(2)));
+					}},
+			{{AdHoc::Lexer::InitialState, "comment"}, regex("\\s+"), [&](auto) {}},
+			{{AdHoc::Lexer::InitialState}, regex("(?:[0-9]+)"),
+					[&](auto es) {
+						tokens.push_back("num:" + std::string(*es->pattern()->match(0)));
+					}},
+			{{AdHoc::Lexer::InitialState}, regex("/\\*"),
+					[&](auto es) {
+						es->pushState("comment");
+					}},
+			{{"comment"}, regex("\\*/"),
+					[&](auto es) {
+						es->popState();
+					}},
+			{{"comment"}, regex("[^*\\s]+|\\*"), [&](auto) {}}};
+}
+
+static std::vector<std::string>
+tokenise(AdHoc::Lexer & l, const std::string & input, bool compile = false)
+{
+	std::vector<std::string> tokens;
+	tokenRules(l, tokens);
+	if (compile) {
+		l.compile();
+	}
+	l.extract(input.c_str(), input.length());
+	return tokens;
+}
+
+BOOST_AUTO_TEST_CASE(compiled)
+{
+	const std::string input {"if abc12 'quo\"te' /* ignore * me */ else 123 \"x\" d"};
+	AdHoc::Lexer plain;
+	AdHoc::Lexer compiled;
+	const auto expected = tokenise(plain, input);
+	BOOST_REQUIRE_EQUAL(expected.size(), 7);
+	BOOST_CHECK_EQUAL(expected[0], "kw:if");
+	BOOST_CHECK_EQUAL(expected[1], "id:abc/12");
+	BOOST_CHECK_EQUAL(expected[2], "str:quo\"te");
+	BOOST_CHECK_EQUAL(expected[3], "kw:else");
+	BOOST_CHECK_EQUAL(expected[4], "num:123");
+	BOOST_CHECK_EQUAL(expected[6], "id:d/");
+	const auto actual = tokenise(compiled, input, true);
+	BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+	BOOST_REQUIRE_THROW(tokenise(compiled, "if ?", true), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(combineRegexen)
+{
+	const std::vector<AdHoc::Lexer::PatternPtr> patterns {regex("a(b)?"), regex("(a)(c)"), regex("(.)\\1"), regex("d")};
+	auto [combination, n] = combine(patterns);
+	BOOST_REQUIRE(combination);
+	BOOST_REQUIRE_EQUAL(n, 2);
+	BOOST_REQUIRE_EQUAL(combination->select("ac", 2, 0).value(), 0);
+	BOOST_REQUIRE_EQUAL(combination->constituent(0)->matchedLength(), 1);
+	BOOST_REQUIRE(!combination->constituent(0)->match(1));
+	BOOST_REQUIRE(!combination->constituent(0)->match(2));
+	BOOST_REQUIRE_EQUAL(combination->select("xac", 3, 1).value(), 0);
+	BOOST_REQUIRE_EQUAL(combination->select("ab", 2, 0).value(), 0);
+	BOOST_REQUIRE_EQUAL(*combination->constituent(0)->match(1), "b");
+	BOOST_REQUIRE(!combination->select("ba", 2, 0));
+	BOOST_REQUIRE(!combination->constituent(1)->matches("ac", 2, 0));
+
+	const std::vector<AdHoc::Lexer::PatternPtr> second {regex("(x)"), regex("(a)(c)")};
+	std::tie(combination, n) = combine(second);
+	BOOST_REQUIRE_EQUAL(n, 2);
+	BOOST_REQUIRE_EQUAL(combination->select("ac", 2, 0).value(), 1);
+	BOOST_REQUIRE_EQUAL(*combination->constituent(1)->match(0), "ac");
+	BOOST_REQUIRE_EQUAL(*combination->constituent(1)->match(1), "a");
+	BOOST_REQUIRE_EQUAL(*combination->constituent(1)->match(2), "c");
+	BOOST_REQUIRE(!combination->constituent(1)->match(3));
+
+	std::tie(combination, n) = combine(std::span(patterns).subspan(2));
+	BOOST_REQUIRE(!combination);
+	BOOST_REQUIRE_EQUAL(n, 0);
+	const std::vector<AdHoc::Lexer::PatternPtr> flags {regex("a"), regex("b", G_REGEX_CASELESS)};
+	std::tie(combination, n) = combine(flags);
+	BOOST_REQUIRE(!combination);
+	BOOST_REQUIRE_EQUAL(n, 1);
+}
+
+BOOST_AUTO_TEST_CASE(executeStateNames)
+{
+	AdHoc::Lexer::ExecuteState es;
+	BOOST_REQUIRE_EQUAL(AdHoc::Lexer::InitialState, es.getState());
+	es.pushState("a");
+	es.pushState("b");
+	es.pushState("a");
+	BOOST_REQUIRE_EQUAL("a", es.getState());
+	es.popState();
+	BOOST_REQUIRE_EQUAL("b", es.getState());
+	es.setState("c");
+	BOOST_REQUIRE_EQUAL("c", es.getState());
+	BOOST_REQUIRE_EQUAL(3, es.depth());
+}
+
+BOOST_AUTO_TEST_CASE(compiledStates)
+{
+	std::string s;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("<"),
+							[&](auto es) {
+								es->pushState("tag");
+							}},
+			{{AdHoc::Lexer::InitialState}, regex("[^<]+"),
+					[&](auto es) {
+						s += *es->pattern()->match(0);
+					}},
+			{{"tag"}, regex(">"),
+					[&](auto es) {
+						es->popState();
+					}},
+			{{"tag"}, regex("[a-z]+"),
+					[&](auto es) {
+						BOOST_REQUIRE_EQUAL("tag", es->getState());
+						es->pushState(*es->pattern()->match(0));
+					}},
+			{{"b", "i"}, regex("/"),
+					[&](auto es) {
+						s += '[' + es->getState() + ']';
+						es->popState();
+					}}});
+	l.compile();
+	l.extract("one<b/>two<i/>", 14);
+	BOOST_REQUIRE_EQUAL("one[b]two[i]", s);
+	BOOST_REQUIRE_THROW(l.extract("<u/>", 4), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(streamed)
+{
+	const std::string input {"if abc12 'quo\"te' /* ignore * me */ else 123 \"x\" d"};
+	AdHoc::Lexer plain;
+	const auto expected = tokenise(plain, input);
+	for (const auto compile : {false, true}) {
+		for (const size_t chunkSize : {1U, 2U, 3U, 7U, 100U}) {
+			BOOST_TEST_CONTEXT(compile << "/" << chunkSize) {
+				std::vector<std::string> tokens;
+				AdHoc::Lexer l;
+				tokenRules(l, tokens);
+				if (compile) {
+					l.compile();
+				}
+				AdHoc::Lexer::Stream stream {l};
+				for (size_t p = 0; p < input.length(); p += chunkSize) {
+					stream.feed(input.data() + p, std::min(chunkSize, input.length() - p));
+				}
+				// Final identifier could yet continue
+				BOOST_CHECK_EQUAL(tokens.size(), expected.size() - 1);
+				stream.finish();
+				BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), tokens.begin(), tokens.end());
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(streamedIncrementally)
+{
+	std::vector<std::pair<size_t, std::string>> tokens;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("[0-9]+"),
+							[&](auto es) {
+								tokens.emplace_back(es->position(), *es->pattern()->match(0));
+							}},
+			{{AdHoc::Lexer::InitialState}, regex("(?<=,)\\s*"), [](auto) {}},
+			{{AdHoc::Lexer::InitialState}, regex(","), [](auto) {}}});
+	AdHoc::Lexer::Stream stream {l, 4, 16};
+	stream.feed("12,3", 4);
+	BOOST_REQUIRE_EQUAL(tokens.size(), 1);
+	BOOST_CHECK_EQUAL(tokens[0].first, 0);
+	BOOST_CHECK_EQUAL(tokens[0].second, "12");
+	stream.feed("4, 5", 4);
+	BOOST_REQUIRE_EQUAL(tokens.size(), 2);
+	BOOST_CHECK_EQUAL(tokens[1].first, 3);
+	BOOST_CHECK_EQUAL(tokens[1].second, "34");
+	for (int i = 0; i < 20; ++i) {
+		stream.feed(",  ", 3);
+	}
+	stream.feed("678", 3);
+	BOOST_REQUIRE_EQUAL(tokens.size(), 3);
+	BOOST_CHECK_EQUAL(tokens[2].second, "5");
+	stream.finish();
+	BOOST_REQUIRE_EQUAL(tokens.size(), 4);
+	BOOST_CHECK_EQUAL(tokens[3].first, 68);
+	BOOST_CHECK_EQUAL(tokens[3].second, "678");
+	BOOST_CHECK_EQUAL(stream.state().position(), 71);
+
+	AdHoc::Lexer::Stream tooLong {l, 4, 16};
+	tooLong.feed("1234567890", 10);
+	BOOST_REQUIRE_THROW(tooLong.feed("1234567890", 10), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(streamedMultibyte)
+{
+	std::vector<std::string> tokens;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("\\w+"),
+							[&](auto es) {
+								tokens.emplace_back(*es->pattern()->match(0));
+							}},
+			{{AdHoc::Lexer::InitialState}, regex(" "), [](auto) {}}});
+	const std::string input {"Michał Górny"};
+	AdHoc::Lexer::Stream stream {l};
+	for (const auto c : input) {
+		stream.feed(&c, 1);
+	}
+	stream.finish();
+	BOOST_REQUIRE_EQUAL(tokens.size(), 2);
+	BOOST_CHECK_EQUAL(tokens[0], "Michał");
+	BOOST_CHECK_EQUAL(tokens[1], "Górny");
+}
+
+BOOST_AUTO_TEST_CASE(rulePatterns)
+{
+	// Handlers can read captures from the rule's own pattern, rather than es->pattern()
+	std::vector<std::string> keys;
+	const auto kv = regex("([a-z]+)=([0-9]+)");
+	const auto nl = regex("\n");
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, kv,
+							[&](auto es) {
+								BOOST_CHECK_EQUAL(es->pattern(), kv);
+								keys.push_back(*kv->match(1));
+							}},
+			{{AdHoc::Lexer::InitialState}, regex(","), [](auto) {}},
+			{{AdHoc::Lexer::InitialState}, nl, [&](auto es) {
+				 BOOST_CHECK_EQUAL(es->pattern(), nl);
+			 }}});
+	l.extract("a=1,bb=2\nccc=3", 14);
+	BOOST_REQUIRE_EQUAL(keys.size(), 3);
+	BOOST_CHECK_EQUAL(keys[0], "a");
+	BOOST_CHECK_EQUAL(keys[1], "bb");
+	BOOST_CHECK_EQUAL(keys[2], "ccc");
+}
+
+BOOST_AUTO_TEST_CASE(concurrentStreams)
+{
+	std::atomic<unsigned int> mismatches {0};
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("([a-z]+)=([0-9]+)"),
+							[&](auto es) {
+								// Each input has a key consistent with its value
+								if ((*es->pattern()->match(1)).length() != (*es->pattern()->match(2)).length()) {
+									mismatches += 1;
+								}
+							}},
+			{{AdHoc::Lexer::InitialState}, regex("\n"), [](auto) {}}});
+	l.compile();
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t <= 4; ++t) {
+		threads.emplace_back([&l, t]() {
+			std::string input;
+			for (int i = 0; i < 1000; ++i) {
+				input += std::string(t, 'k') + '=' + std::string(t, '1') + '\n';
+			}
+			AdHoc::Lexer::Stream stream {l};
+			stream.feed(input.c_str(), input.length());
+			stream.finish();
+		});
+	}
+	for (auto & t : threads) {
+		t.join();
+	}
+	BOOST_REQUIRE_EQUAL(mismatches, 0);
+}
+
+BOOST_AUTO_TEST_CASE(parallelExtract)
+{
+	std::string input;
+	for (unsigned int i = 0; i < 10000; ++i) {
+		input += "rec" + std::to_string(i) + " = " + std::to_string(i * 2) + ";\n";
+	}
+	std::mutex lock;
+	std::set<std::pair<size_t, std::string>> values;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("rec[0-9]+ = ([0-9]+);"),
+							[&](auto es) {
+								std::lock_guard<std::mutex> g {lock};
+								values.emplace(es->position(), *es->pattern()->match(1));
+							}},
+			{{AdHoc::Lexer::InitialState}, regex("\n"), [](auto) {}}});
+	std::set<std::pair<size_t, std::string>> expected;
+	l.extract(input.c_str(), input.length());
+	std::swap(expected, values);
+	BOOST_REQUIRE_EQUAL(expected.size(), 10000);
+	l.compile();
+	for (const auto pieces : {1U, 3U, 8U}) {
+		values.clear();
+		l.extractParallel(input.c_str(), input.length(), "\n", pieces);
+		BOOST_CHECK(values == expected);
+	}
+	BOOST_REQUIRE_THROW(l.extractParallel("rec1 = 2;\nbad\n", 15, "\n", 2), std::runtime_error);
+}
+
+// A pattern written before matchView() existed, implementing only match()
+class DigitsPattern : public AdHoc::Lexer::Pattern {
+public:
+	bool
+	matches(const gchar * string, size_t length, size_t position) const override
+	{
+		const std::string_view input {string + position, length - position};
+		matched = input.substr(0, input.find_first_not_of("0123456789"));
+		return !matched.empty();
+	}
+
+	size_t
+	matchedLength() const override
+	{
+		return matched.length();
+	}
+
+	std::optional<Glib::ustring>
+	match(int n) const override
+	{
+		if (n == 0) {
+			return Glib::ustring(std::string {matched});
+		}
+		return {};
+	}
+
+private:
+	mutable std::string_view matched;
+};
+
+BOOST_AUTO_TEST_CASE(matchOnlyPattern)
+{
+	std::vector<std::string> numbers;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, std::make_shared<DigitsPattern>(),
+							[&](auto es) {
+								BOOST_REQUIRE(es->pattern()->matchView(0));
+								BOOST_CHECK(!es->pattern()->matchView(1));
+								numbers.emplace_back(*es->pattern()->matchView(0));
+								BOOST_CHECK_EQUAL(numbers.back(), std::string {*es->pattern()->match(0)});
+							}},
+			{{AdHoc::Lexer::InitialState}, regex(" "), [](auto) {}}});
+	l.extract("12 345 6", 8);
+	BOOST_REQUIRE_EQUAL(numbers.size(), 3);
+	BOOST_CHECK_EQUAL(numbers[0], "12");
+	BOOST_CHECK_EQUAL(numbers[1], "345");
+	BOOST_CHECK_EQUAL(numbers[2], "6");
+}
+
+BOOST_AUTO_TEST_CASE(streamedDefaultPartial)
+{
+	// Without its own matchesPartial, a pattern's failures aren't conclusive, so input is held back until finish
+	std::vector<std::string> numbers;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, std::make_shared<DigitsPattern>(),
+							[&](auto es) {
+								numbers.emplace_back(*es->pattern()->matchView(0));
+							}},
+			{{AdHoc::Lexer::InitialState}, regex(" "), [](auto) {}}});
+	AdHoc::Lexer::Stream stream {l};
+	stream.feed("12 34", 5);
+	BOOST_REQUIRE_EQUAL(numbers.size(), 1);
+	stream.feed(" 56", 3);
+	BOOST_REQUIRE_EQUAL(numbers.size(), 1);
+	stream.finish();
+	BOOST_REQUIRE_EQUAL(numbers.size(), 3);
+	BOOST_CHECK_EQUAL(numbers[1], "34");
+	BOOST_CHECK_EQUAL(numbers[2], "56");
+}
+
+BOOST_AUTO_TEST_CASE(matchViews)
+{
+	const std::string input {"key=value;other="};
+	std::vector<std::string_view> views;
+	AdHoc::Lexer l({{{AdHoc::Lexer::InitialState}, regex("([a-z]+)=([a-z]+)?;?"), [&](auto es) {
+						 const auto & p = es->pattern();
+						 BOOST_REQUIRE(p->matchView(1));
+						 views.push_back(*p->matchView(1));
+						 if (const auto v = p->matchView(2)) {
+							 views.push_back(*v);
+							 BOOST_CHECK_EQUAL(*p->match(2), std::string(*v));
+						 }
+						 BOOST_CHECK(!p->matchView(3));
+					 }}});
+	for (const auto compile : {false, true}) {
+		views.clear();
+		if (compile) {
+			l.compile();
+		}
+		l.extract(input.c_str(), input.length());
+		BOOST_REQUIRE_EQUAL(views.size(), 3);
+		BOOST_CHECK_EQUAL(views[0], "key");
+		BOOST_CHECK_EQUAL(views[1], "value");
+		BOOST_CHECK_EQUAL(views[2], "other");
+		// Views refer to the input itself
+		BOOST_CHECK_EQUAL(views[0].data(), input.data());
+		BOOST_CHECK_EQUAL(views[1].data(), input.data() + 4);
+		BOOST_CHECK_EQUAL(views[2].data(), input.data() + 10);
+	}
+}
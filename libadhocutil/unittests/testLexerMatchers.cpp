@@ -0,0 +1,192 @@
+#define BOOST_TEST_MODULE LexerMatchers
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <lexer-matchers.h>
+#include <lexer-regex.h>
+#include <string>
+#include <vector>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#ifndef __clang__
+#	pragma GCC diagnostic ignored "-Wuseless-cast"
+#endif
+#include <glibmm/ustring.h>
+#pragma GCC diagnostic pop
+
+using namespace AdHoc;
+using namespace AdHoc::LexerMatchers;
+
+BOOST_AUTO_TEST_CASE(literalMatch)
+{
+	const auto p = literal("else");
+	BOOST_REQUIRE(p->matches("if else", 7, 3));
+	BOOST_REQUIRE_EQUAL(4, p->matchedLength());
+	BOOST_REQUIRE_EQUAL("else", *p->match(0));
+	BOOST_REQUIRE(!p->match(1));
+	BOOST_REQUIRE(!p->matches("if else", 7, 2));
+	BOOST_REQUIRE(!p->matches("if els", 6, 3));
+	BOOST_REQUIRE(!literal("")->matches("x", 1, 0));
+}
+
+BOOST_AUTO_TEST_CASE(literalSet)
+{
+	const auto p = literals({"=", "==", "<", "<=", "!="});
+	BOOST_REQUIRE(p->matches("a == b", 6, 2));
+	BOOST_REQUIRE_EQUAL(2, p->matchedLength());
+	BOOST_REQUIRE(p->matches("a = b", 5, 2));
+	BOOST_REQUIRE_EQUAL(1, p->matchedLength());
+	BOOST_REQUIRE(p->matches("a <", 3, 2));
+	BOOST_REQUIRE_EQUAL("<", *p->match(0));
+	BOOST_REQUIRE(!p->matches("a ! b", 5, 2));
+	BOOST_REQUIRE(!p->matches("a", 1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(classDefinition)
+{
+	const CharClass alnum {"a-zA-Z0-9_"};
+	BOOST_CHECK(alnum.contains('a'));
+	BOOST_CHECK(alnum.contains('q'));
+	BOOST_CHECK(alnum.contains('Z'));
+	BOOST_CHECK(alnum.contains('5'));
+	BOOST_CHECK(alnum.contains('_'));
+	BOOST_CHECK(!alnum.contains('-'));
+	BOOST_CHECK(!alnum.contains(' '));
+	BOOST_CHECK(!alnum.contains('\xe9'));
+	const CharClass notSpace {"^ \t\n"};
+	BOOST_CHECK(notSpace.contains('x'));
+	BOOST_CHECK(notSpace.contains('\xe9'));
+	BOOST_CHECK(notSpace.contains('\0'));
+	BOOST_CHECK(!notSpace.contains(' '));
+	BOOST_CHECK(!notSpace.contains('\n'));
+	const CharClass dash {"-+"};
+	BOOST_CHECK(dash.contains('-'));
+	BOOST_CHECK(dash.contains('+'));
+	BOOST_CHECK(!dash.contains(','));
+}
+
+BOOST_AUTO_TEST_CASE(classSpanAllBytes)
+{
+	// Every byte value, in and out of class, at every offset within and beyond a vector block
+	std::string all;
+	for (int c = 0; c < 256; ++c) {
+		all += static_cast<char>(c);
+	}
+	for (const auto & def : {"a-z", "^a-z", "\x80-\xff", "\x01-\x7f", "0-9\xc0-\xcf_"}) {
+		const CharClass cls {def};
+		for (int c = 0; c < 256; ++c) {
+			for (size_t run = 0; run < 70; run += 7) {
+				std::string input;
+				const char member = all[static_cast<size_t>(std::find_if(all.begin(), all.end(), [&](char x) {
+					return cls.contains(x);
+				}) - all.begin())];
+				input.append(run, member);
+				input += static_cast<char>(c);
+				input.append(40, member);
+				const auto expected = cls.contains(static_cast<char>(c)) ? input.length() : run;
+				BOOST_REQUIRE_EQUAL(expected, cls.span(input.data(), input.length()));
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(classMatchers)
+{
+	const auto ws = charRun(" \t\n");
+	const std::string input {"  \t\n  x"};
+	BOOST_REQUIRE(ws->matches(input.c_str(), input.length(), 0));
+	BOOST_REQUIRE_EQUAL(6, ws->matchedLength());
+	BOOST_REQUIRE(!ws->matches(input.c_str(), input.length(), 6));
+	BOOST_REQUIRE(!ws->matches(input.c_str(), input.length(), 7));
+
+	const auto ident = charRun("a-zA-Z_", "a-zA-Z0-9_");
+	BOOST_REQUIRE(ident->matches("foo_12+", 7, 0));
+	BOOST_REQUIRE_EQUAL("foo_12", *ident->match(0));
+	BOOST_REQUIRE_EQUAL("foo_12", *ident->matchView(0));
+	BOOST_REQUIRE(!ident->matchView(1));
+	BOOST_REQUIRE(!ident->matches("1foo", 4, 0));
+	BOOST_REQUIRE(ident->matches("x", 1, 0));
+	BOOST_REQUIRE_EQUAL(1, ident->matchedLength());
+
+	const auto punct = charClass("(){};");
+	BOOST_REQUIRE(punct->matches("{}", 2, 1));
+	BOOST_REQUIRE_EQUAL(1, punct->matchedLength());
+	BOOST_REQUIRE(!punct->matches("{}", 2, 2));
+	BOOST_REQUIRE(!punct->matches("a", 1, 0));
+}
+
+BOOST_AUTO_TEST_CASE(mixedRules)
+{
+	std::vector<std::string> tokens;
+	AdHoc::Lexer l({{{Lexer::InitialState}, literals({"if", "else"}),
+							[&](auto es) {
+								tokens.push_back("kw:" + std::string(*es->pattern()->match(0)));
+							}},
+			{{Lexer::InitialState}, regex("[0-9]+\\.[0-9]+"),
+					[&](auto es) {
+						tokens.push_back("float:" + std::string(*es->pattern()->match(0)));
+					}},
+			{{Lexer::InitialState}, charRun("0-9"),
+					[&](auto es) {
+						tokens.push_back("int:" + std::string(*es->pattern()->match(0)));
+					}},
+			{{Lexer::InitialState}, charRun("a-z", "a-z0-9"),
+					[&](auto es) {
+						tokens.push_back("id:" + std::string(*es->pattern()->match(0)));
+					}},
+			{{Lexer::InitialState}, charRun(" "), [](auto) {}}});
+	for (const auto compile : {false, true}) {
+		tokens.clear();
+		if (compile) {
+			l.compile();
+		}
+		l.extract("if x1 1.5 else 42", 17);
+		BOOST_REQUIRE_EQUAL(tokens.size(), 5);
+		BOOST_CHECK_EQUAL(tokens[0], "kw:if");
+		BOOST_CHECK_EQUAL(tokens[1], "id:x1");
+		BOOST_CHECK_EQUAL(tokens[2], "float:1.5");
+		BOOST_CHECK_EQUAL(tokens[3], "kw:else");
+		BOOST_CHECK_EQUAL(tokens[4], "int:42");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(partialMatches)
+{
+	BOOST_CHECK(literal("else")->matchesPartial("el", 2, 0) == Lexer::PartialResult::NeedMore);
+	BOOST_CHECK(literal("else")->matchesPartial("ex", 2, 0) == Lexer::PartialResult::NoMatch);
+	BOOST_CHECK(literal("else")->matchesPartial("else", 4, 0) == Lexer::PartialResult::Match);
+	BOOST_CHECK(literals({"=", "=="})->matchesPartial("=", 1, 0) == Lexer::PartialResult::NeedMore);
+	BOOST_CHECK(literals({"=", "=="})->matchesPartial("=x", 2, 0) == Lexer::PartialResult::Match);
+	BOOST_CHECK(literals({"=", "=="})->matchesPartial("x", 1, 0) == Lexer::PartialResult::NoMatch);
+	BOOST_CHECK(charClass("a")->matchesPartial("a", 1, 1) == Lexer::PartialResult::NeedMore);
+	BOOST_CHECK(charClass("a")->matchesPartial("a", 1, 0) == Lexer::PartialResult::Match);
+	BOOST_CHECK(charRun("a")->matchesPartial("aa", 2, 0) == Lexer::PartialResult::NeedMore);
+	BOOST_CHECK(charRun("a")->matchesPartial("aab", 3, 0) == Lexer::PartialResult::Match);
+	BOOST_CHECK(charRun("a")->matchesPartial("b", 1, 0) == Lexer::PartialResult::NoMatch);
+}
+
+BOOST_AUTO_TEST_CASE(streamedMatchers)
+{
+	std::vector<std::string> tokens;
+	AdHoc::Lexer l({{{Lexer::InitialState}, literals({"=", "=="}),
+							[&](auto es) {
+								tokens.emplace_back(*es->pattern()->match(0));
+							}},
+			{{Lexer::InitialState}, charRun("a-z"),
+					[&](auto es) {
+						tokens.emplace_back(*es->pattern()->match(0));
+					}}});
+	Lexer::Stream stream {l};
+	for (const auto c : std::string {"abc==de=f"}) {
+		stream.feed(&c, 1);
+	}
+	BOOST_REQUIRE_EQUAL(tokens.size(), 4);
+	stream.finish();
+	BOOST_REQUIRE_EQUAL(tokens.size(), 5);
+	BOOST_CHECK_EQUAL(tokens[0], "abc");
+	BOOST_CHECK_EQUAL(tokens[1], "==");
+	BOOST_CHECK_EQUAL(tokens[2], "de");
+	BOOST_CHECK_EQUAL(tokens[3], "=");
+	BOOST_CHECK_EQUAL(tokens[4], "f");
+}
@@ -1,12 +1,20 @@
 #define BOOST_TEST_MODULE NvpParse
 #include <boost/test/unit_test.hpp>
 
+#include "fileUtils.h"
 #include "nvpParse.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iosfwd>
+#include <limits>
 #include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 using namespace AdHoc;
 
@@ -62,3 +70,170 @@ BOOST_AUTO_TEST_CASE(bad)
 	std::stringstream i("{bad=");
 	BOOST_REQUIRE_THROW(NvpParse::parse(i, TestTargetMap, tt), std::runtime_error);
 }
+
+BOOST_AUTO_TEST_CASE(parseView)
+{
+	const NvpParse::Table<TestTarget> table {TestTargetMap};
+	TestTarget tt;
+	NvpParse::parse(std::string_view {"a=\tfoo bar ;b= bar\n;\nc=+3;d=-3.5e2;"}, table, tt);
+	BOOST_CHECK_EQUAL("\tfoo bar ", tt.a);
+	BOOST_CHECK_EQUAL("bar\n", tt.b);
+	BOOST_CHECK_EQUAL(3, tt.c);
+	BOOST_CHECK_EQUAL(-350, tt.d);
+	// Table is reusable
+	NvpParse::parse(std::string_view {"c=-12"}, table, tt);
+	BOOST_CHECK_EQUAL(-12, tt.c);
+	BOOST_CHECK_EQUAL("bar\n", tt.b);
+}
+
+BOOST_AUTO_TEST_CASE(parseViewErrors)
+{
+	const NvpParse::Table<TestTarget> table {TestTargetMap};
+	TestTarget tt;
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"c=3x"}, table, tt), boost::bad_lexical_cast);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"c=99999999999"}, table, tt), boost::bad_lexical_cast);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"e=1"}, table, tt), NvpParse::ValueNotFound);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"a=1;;"}, table, tt), std::runtime_error);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"a 1"}, table, tt), std::runtime_error);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"c=1 b=2"}, table, tt), boost::bad_lexical_cast);
+}
+
+class TypedTarget {
+public:
+	unsigned int u {0};
+	uint8_t byte {0};
+	char ch {0};
+};
+
+NvpTarget(TypedTarget) TypedTargetMap {
+		NvpValue(TypedTarget, u),
+		NvpValue(TypedTarget, byte),
+		NvpValue(TypedTarget, ch),
+};
+
+BOOST_AUTO_TEST_CASE(lexicalCastCompatible)
+{
+	// Conversions as lexical_cast, as when parsed with the original flex scanner
+	const NvpParse::Table<TypedTarget> table {TypedTargetMap};
+	TypedTarget tt;
+	NvpParse::parse(std::string_view {"u=-1;byte=5;ch=x"}, table, tt);
+	BOOST_CHECK_EQUAL(std::numeric_limits<unsigned int>::max(), tt.u);
+	BOOST_CHECK_EQUAL('5', tt.byte);
+	BOOST_CHECK_EQUAL('x', tt.ch);
+	NvpParse::parse(std::string_view {"u=+7"}, table, tt);
+	BOOST_CHECK_EQUAL(7, tt.u);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"byte=55"}, table, tt), boost::bad_lexical_cast);
+	BOOST_CHECK_THROW(NvpParse::parse(std::string_view {"u=--1"}, table, tt), boost::bad_lexical_cast);
+}
+
+BOOST_AUTO_TEST_CASE(parseCallback)
+{
+	std::vector<std::pair<std::string, std::string>> values;
+	NvpParse::parse(" name.sub-part = value ; other_1=x;last=", [&values](auto n, auto v) {
+		values.emplace_back(n, v);
+	});
+	BOOST_REQUIRE_EQUAL(values.size(), 2);
+	BOOST_CHECK_EQUAL(values[0].first, "name.sub-part");
+	BOOST_CHECK_EQUAL(values[0].second, "value ");
+	BOOST_CHECK_EQUAL(values[1].first, "other_1");
+	BOOST_CHECK_EQUAL(values[1].second, "x");
+	BOOST_CHECK_THROW(NvpParse::parse("name.=x", [](auto, auto) {}), std::runtime_error);
+	// A value can begin with ;
+	values.clear();
+	NvpParse::parse("a=;b=2", [&values](auto n, auto v) {
+		values.emplace_back(n, v);
+	});
+	BOOST_REQUIRE_EQUAL(values.size(), 1);
+	BOOST_CHECK_EQUAL(values[0].first, "a");
+	BOOST_CHECK_EQUAL(values[0].second, ";b=2");
+}
+
+BOOST_AUTO_TEST_CASE(splitLines)
+{
+	BOOST_CHECK(NvpParse::splitLines("", 4).empty());
+	const auto one = NvpParse::splitLines("a\nb\nc", 1);
+	BOOST_REQUIRE_EQUAL(one.size(), 1);
+	BOOST_CHECK_EQUAL(one[0], "a\nb\nc");
+	for (const auto pieces : {2U, 3U, 5U}) {
+		const std::string_view in {"aaaa\nb\nc\ndddd\neeeeeeeeee\nf"};
+		const auto split = NvpParse::splitLines(in, pieces);
+		BOOST_REQUIRE_LE(split.size(), pieces);
+		BOOST_REQUIRE_GT(split.size(), 1);
+		std::string joined;
+		for (const auto & piece : split) {
+			BOOST_CHECK(!piece.empty());
+			BOOST_CHECK(&piece == &split.back() || piece.ends_with('\n'));
+			joined += piece;
+		}
+		BOOST_CHECK_EQUAL(joined, in);
+	}
+}
+
+static std::string
+records(unsigned int n)
+{
+	std::string in;
+	for (unsigned int i = 0; i < n; ++i) {
+		in += "a=rec" + std::to_string(i) + ";c=" + std::to_string(i) + ";d=" + std::to_string(i) + ".5";
+		in += (i % 2) ? "\r\n" : "\n";
+		if (i % 7 == 0) {
+			in += " \n";
+		}
+	}
+	return in;
+}
+
+static void
+checkRecords(const std::vector<TestTarget> & out, unsigned int n)
+{
+	BOOST_REQUIRE_EQUAL(out.size(), n);
+	for (unsigned int i = 0; i < n; ++i) {
+		BOOST_REQUIRE_EQUAL(out[i].a, "rec" + std::to_string(i));
+		BOOST_REQUIRE(out[i].b.empty());
+		BOOST_REQUIRE_EQUAL(out[i].c, i);
+		BOOST_REQUIRE_EQUAL(out[i].d, i + 0.5);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(parseRecords)
+{
+	const NvpParse::Table<TestTarget> table {TestTargetMap};
+	const auto in = records(1000);
+	for (const auto threads : {1U, 2U, 7U, 64U}) {
+		BOOST_TEST_CONTEXT(threads) {
+			checkRecords(NvpParse::parseRecords(in, table, threads), 1000);
+		}
+	}
+	std::stringstream s {in};
+	std::vector<TestTarget> out;
+	NvpParse::parseRecords(s, table, out);
+	checkRecords(out, 1000);
+	BOOST_CHECK_THROW(NvpParse::parseRecords("a=1\nc=x\n", table, 2), boost::bad_lexical_cast);
+}
+
+BOOST_AUTO_TEST_CASE(parseRecordsFail)
+{
+	// Records parsed before a failure are kept, but the failed one isn't appended half filled
+	const NvpParse::Table<TestTarget> table {TestTargetMap};
+	std::vector<TestTarget> out(1);
+	BOOST_CHECK_THROW(NvpParse::parseRecords("a=one\na=two;c=x\na=three\n", table, out), boost::bad_lexical_cast);
+	BOOST_REQUIRE_EQUAL(out.size(), 2);
+	BOOST_CHECK_EQUAL(out[1].a, "one");
+	std::stringstream s {"a=four\nb=five;e=6\n"};
+	BOOST_CHECK_THROW(NvpParse::parseRecords(s, table, out), NvpParse::ValueNotFound);
+	BOOST_REQUIRE_EQUAL(out.size(), 3);
+	BOOST_CHECK_EQUAL(out[2].a, "four");
+}
+
+BOOST_AUTO_TEST_CASE(parseRecordsMemMap)
+{
+	const NvpParse::Table<TestTarget> table {TestTargetMap};
+	const auto path = std::filesystem::temp_directory_path() / "testNvpParse-records";
+	{
+		std::ofstream f {path};
+		f << records(100);
+	}
+	const FileUtils::MemMap mm {path};
+	checkRecords(NvpParse::parseRecords(mm, table, 4), 100);
+	std::filesystem::remove(path);
+}
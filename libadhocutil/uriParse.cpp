@@ -1,56 +1,231 @@
 #include "uriParse.h"
+#include "charClass.h"
 #include "compileTimeFormatter.h"
 #include <algorithm>
-#include <boost/algorithm/string/case_conv.hpp>
-#include <cctype>
+#include <array>
 #include <charconv>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 namespace AdHoc {
-	Uri::Uri(const std::string & uri)
-	{
-		auto is_scheme_char = [](int c) {
-			return (!std::isalpha(c) && '+' != c && '-' != c && '.' != c) ? 0 : 1;
-		};
-		auto endor = [](std::string_view haystack, auto needle) {
-			if (const auto n = haystack.find_first_of(needle); n != std::string_view::npos) {
-				return n;
+	namespace {
+		// Delimiter searches, as spans of the bytes which are not the delimiters
+		const CharClass schemeChars {"a-zA-Z+.-"};
+		const CharClass userInfoChars {"^@/"};
+		const CharClass hostChars {"^:/"};
+		const CharClass pathChars {"^#?"};
+
+		// RFC 3986 permitted characters, for validation; the parser itself is more lenient
+		const CharClass validUserInfo {"a-zA-Z0-9._~!$&'()*+,;=%:-"};
+		const CharClass validHost {"a-zA-Z0-9._~!$&'()*+,;=%-"};
+		const CharClass validIpv6 {"0-9a-fA-F:."};
+		const CharClass validPath {"a-zA-Z0-9._~!$&'()*+,;=%:@/-"};
+		const CharClass validQuery {"a-zA-Z0-9._~!$&'()*+,;=%:@/?-"};
+
+		// Characters left as they are in normalised output; anything else is percent-encoded
+		const CharClass unreserved {"a-zA-Z0-9._~-"};
+		const CharClass keepUserInfo {"a-zA-Z0-9._~!$&'()*+,;=:-"};
+		const CharClass keepHost {"a-zA-Z0-9._~!$&'()*+,;=-"};
+		const CharClass keepPath {"a-zA-Z0-9._~!$&'()*+,;=:@/-"};
+		const CharClass keepQueryName {"a-zA-Z0-9._~!$'()*+,;:@/?-"};
+		const CharClass keepQueryValue {"a-zA-Z0-9._~!$'()*+,;=:@/?-"};
+		const CharClass keepFragment {"a-zA-Z0-9._~!$&'()*+,;=:@/?-"};
+
+		constexpr std::string_view HEX {"0123456789ABCDEF"};
+		constexpr unsigned int NIBBLE = 4;
+
+		constexpr std::array<std::pair<std::string_view, uint16_t>, 5> DEFAULT_PORTS {{
+				{"ftp", 21},
+				{"http", 80},
+				{"https", 443},
+				{"ws", 80},
+				{"wss", 443},
+		}};
+
+		size_t
+		endor(std::string_view haystack, char needle)
+		{
+			return std::min(haystack.find(needle), haystack.length());
+		}
+
+		size_t
+		span(const CharClass & chars, std::string_view in)
+		{
+			return chars.span(in.data(), in.length());
+		}
+
+		constexpr char
+		lower(char c)
+		{
+			return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		std::string
+		toLower(std::string_view in)
+		{
+			std::string out {in};
+			std::transform(out.begin(), out.end(), out.begin(), lower);
+			return out;
+		}
+
+		constexpr std::optional<unsigned int>
+		hexValue(char c)
+		{
+			if (c >= '0' && c <= '9') {
+				return static_cast<unsigned int>(c - '0');
 			}
-			return haystack.length();
-		};
-		auto parsePort = [&uri, this](const std::string_view in) {
+			if (const auto l = lower(c); l >= 'a' && l <= 'f') {
+				return static_cast<unsigned int>(l - 'a' + 10);
+			}
+			return {};
+		}
+
+		// The byte encoded by the escape at the start of in, if well formed
+		std::optional<char>
+		escaped(std::string_view in)
+		{
+			if (in.length() < 3 || in.front() != '%') {
+				return {};
+			}
+			const auto high = hexValue(in[1]), low = hexValue(in[2]);
+			if (!high || !low) {
+				return {};
+			}
+			return static_cast<char>((*high << NIBBLE) | *low);
+		}
+
+		void
+		appendEscape(std::string & out, char c)
+		{
+			const auto b = static_cast<unsigned char>(c);
+			out += '%';
+			out += HEX[b >> NIBBLE];
+			out += HEX[b & 0x0FU];
+		}
+
+		// Append in, runs of characters to keep at a time, decoding escapes of unreserved characters and
+		// escaping everything else
+		void
+		appendNormalised(std::string & out, std::string_view in, const CharClass & keep, bool fold = false)
+		{
+			while (!in.empty()) {
+				const auto run = span(keep, in);
+				if (fold) {
+					std::transform(in.begin(), in.begin() + static_cast<std::ptrdiff_t>(run), std::back_inserter(out),
+							lower);
+				}
+				else {
+					out.append(in.substr(0, run));
+				}
+				in.remove_prefix(run);
+				if (in.empty()) {
+					break;
+				}
+				if (const auto c = escaped(in)) {
+					if (unreserved.contains(*c)) {
+						out += fold ? lower(*c) : *c;
+					}
+					else {
+						appendEscape(out, *c);
+					}
+					in.remove_prefix(3);
+				}
+				else {
+					appendEscape(out, in.front());
+					in.remove_prefix(1);
+				}
+			}
+		}
+
+		// Append the (already normalised, relative) path as an absolute path, removing dot segments as
+		// RFC 3986 5.2.4
+		void
+		appendPath(std::string & out, std::string_view path)
+		{
+			const auto root = out.length();
+			out += '/';
+			while (true) {
+				const auto end = endor(path, '/');
+				const auto segment = path.substr(0, end);
+				const bool last = end == path.length();
+				if (segment == "..") {
+					if (out.length() > root + 1) {
+						out.resize(out.rfind('/', out.length() - 2) + 1);
+					}
+				}
+				else if (segment != ".") {
+					out.append(segment);
+					if (!last) {
+						out += '/';
+					}
+				}
+				if (last) {
+					break;
+				}
+				path.remove_prefix(end + 1);
+			}
+		}
+
+		UriView::Error
+		validate(std::string_view in, const CharClass & chars)
+		{
+			if (span(chars, in) != in.length()) {
+				return UriView::Error::InvalidCharacter;
+			}
+			for (auto p = in.find('%'); p != std::string_view::npos; p = in.find('%', p + 1)) {
+				if (!escaped(in.substr(p))) {
+					return UriView::Error::BadEscape;
+				}
+			}
+			return UriView::Error::None;
+		}
+	}
+
+	UriView::UriView(std::string_view uri)
+	{
+		if (const auto e = parse(uri); e != Error::None) {
+			throw InvalidUri(describe(e), std::string {uri});
+		}
+	}
+
+	UriView::Error
+	UriView::parse(std::string_view uri) noexcept
+	{
+		*this = {};
+		auto parsePort = [this](const std::string_view in) {
 			if (in.empty()) {
-				throw InvalidUri("Invalid format; no port after :", uri);
+				return Error::NoPort;
 			}
 			port.emplace();
 			if (const auto rc = std::from_chars(in.begin(), in.end(), *port);
 					rc.ptr != in.end() || rc.ec != std::errc {}) {
-				throw InvalidUri("Invalid port", uri);
+				return Error::BadPort;
 			}
+			return Error::None;
 		};
 
 		std::string_view curstr = uri;
-		if (auto colon = curstr.find(':'); colon == std::string_view::npos) {
-			throw InvalidUri("Scheme marker not found", uri);
+		if (const auto colon = span(schemeChars, curstr); colon == curstr.length() || curstr[colon] != ':') {
+			return (curstr.find(':', colon) == std::string_view::npos) ? Error::NoSchemeMarker : Error::BadScheme;
 		}
 		else {
-			if (!std::all_of(curstr.begin(), curstr.begin() + colon, is_scheme_char)) {
-				throw InvalidUri("Invalid format; no scheme end", uri);
-			}
 			scheme = curstr.substr(0, colon);
-			boost::algorithm::to_lower(scheme);
 			curstr.remove_prefix(colon + 1);
 		}
 
 		if (!curstr.starts_with("//")) {
-			throw InvalidUri("Invalid format; // not where expected", uri);
+			return Error::NoSlashes;
 		}
 		curstr.remove_prefix(2);
 
-		if (const auto n = curstr.find_first_of("@/"); n != std::string_view::npos && curstr[n] == '@') {
+		if (const auto n = span(userInfoChars, curstr); n != curstr.length() && curstr[n] == '@') {
 			if (const auto colon = curstr.find_first_of("@:"); curstr[colon] == ':') {
 				username = curstr.substr(0, colon);
 				password = curstr.substr(colon + 1, n - colon - 1);
@@ -62,11 +237,11 @@ namespace AdHoc {
 		}
 
 		if (curstr.empty()) {
-			throw InvalidUri("Invalid format", uri);
+			return Error::NoHost;
 		}
 		if (curstr.starts_with('[')) {
 			if (const auto closeb = curstr.find(']'); closeb == std::string_view::npos) {
-				throw InvalidUri("IPv6 address not terminated", uri);
+				return Error::UnterminatedIpv6;
 			}
 			else {
 				host = curstr.substr(0, closeb + 1);
@@ -74,70 +249,286 @@ namespace AdHoc {
 			}
 		}
 		else {
-			if (const auto hostend = curstr.find_first_of(":/"); hostend == std::string_view::npos) {
-				host = curstr;
-				return;
-			}
-			else {
-				if (hostend == 0) {
-					throw InvalidUri("Host cannot be blank", uri);
-				}
-				host = curstr.substr(0, hostend);
-				boost::algorithm::to_lower(host);
-				curstr.remove_prefix(hostend);
+			const auto hostend = span(hostChars, curstr);
+			if (hostend == 0) {
+				return Error::BlankHost;
 			}
+			host = curstr.substr(0, hostend);
+			curstr.remove_prefix(hostend);
 		}
-		boost::algorithm::to_lower(host);
 
 		if (curstr.empty()) {
-			return;
+			return Error::None;
 		}
 		if (curstr.starts_with(':')) {
 			curstr.remove_prefix(1);
+			const auto portend = endor(curstr, '/');
+			if (const auto e = parsePort(curstr.substr(0, portend)); e != Error::None) {
+				return e;
+			}
+			curstr.remove_prefix(portend);
 			if (curstr.empty()) {
-				throw InvalidUri("Invalid format; no port after :", uri);
+				return Error::None;
 			}
-			if (const auto portend = curstr.find('/'); portend == std::string_view::npos) {
-				parsePort(curstr);
-				return;
+		}
+		curstr.remove_prefix(1);
+
+		const auto pathend = span(pathChars, curstr);
+		path = curstr.substr(0, pathend);
+		curstr.remove_prefix(pathend);
+
+		if (curstr.starts_with('?')) {
+			curstr.remove_prefix(1);
+			query = curstr.substr(0, endor(curstr, '#'));
+			curstr.remove_prefix(query->length());
+		}
+
+		if (curstr.starts_with('#')) {
+			curstr.remove_prefix(1);
+			fragment = curstr;
+		}
+		return Error::None;
+	}
+
+	const char *
+	UriView::describe(Error e) noexcept
+	{
+		switch (e) {
+			case Error::None:
+				return "No error";
+			case Error::NoSchemeMarker:
+				return "Scheme marker not found";
+			case Error::BadScheme:
+				return "Invalid format; no scheme end";
+			case Error::NoSlashes:
+				return "Invalid format; // not where expected";
+			case Error::NoHost:
+				return "Invalid format";
+			case Error::UnterminatedIpv6:
+				return "IPv6 address not terminated";
+			case Error::BlankHost:
+				return "Host cannot be blank";
+			case Error::NoPort:
+				return "Invalid format; no port after :";
+			case Error::BadPort:
+				return "Invalid port";
+			case Error::InvalidCharacter:
+				return "Invalid character";
+			case Error::BadEscape:
+				return "Malformed percent escape";
+		}
+		return "Unknown error";
+	}
+
+	UriView::Error
+	UriView::validate() const noexcept
+	{
+		auto check = [](const std::optional<std::string_view> & component, const CharClass & chars) {
+			return component ? AdHoc::validate(*component, chars) : Error::None;
+		};
+		if (host.starts_with('[')) {
+			if (!host.ends_with(']') || span(validIpv6, host.substr(1, host.length() - 2)) != host.length() - 2) {
+				return Error::InvalidCharacter;
 			}
-			else {
-				parsePort(curstr.substr(0, portend));
-				curstr.remove_prefix(portend);
+		}
+		else if (const auto e = AdHoc::validate(host, validHost); e != Error::None) {
+			return e;
+		}
+		for (const auto & [component, chars] : {std::make_pair(&username, &validUserInfo),
+					 std::make_pair(&password, &validUserInfo), std::make_pair(&path, &validPath),
+					 std::make_pair(&query, &validQuery), std::make_pair(&fragment, &validQuery)}) {
+			if (const auto e = check(*component, *chars); e != Error::None) {
+				return e;
 			}
 		}
-		curstr.remove_prefix(1);
+		return Error::None;
+	}
 
-		if (const auto pathend = curstr.find_first_of("#?"); pathend == std::string_view::npos) {
-			path = curstr;
-			return;
+	std::string
+	UriView::normalise() const
+	{
+		std::string out;
+		normalise(out);
+		return out;
+	}
+
+	void
+	UriView::normalise(std::string & out) const
+	{
+		out.clear();
+		out.reserve(scheme.length() + host.length() + path.value_or("").length() + query.value_or("").length()
+				+ fragment.value_or("").length() + 16);
+		std::transform(scheme.begin(), scheme.end(), std::back_inserter(out), lower);
+		out += "://";
+		if (username) {
+			appendNormalised(out, *username, keepUserInfo);
+			if (password) {
+				out += ':';
+				appendNormalised(out, *password, keepUserInfo);
+			}
+			out += '@';
+		}
+		if (host.starts_with('[')) {
+			std::transform(host.begin(), host.end(), std::back_inserter(out), lower);
 		}
 		else {
-			path = curstr.substr(0, pathend);
-			curstr.remove_prefix(pathend);
+			appendNormalised(out, host, keepHost, true);
 		}
-
-		if (curstr.starts_with('?')) {
-			curstr.remove_prefix(1);
-			auto params = curstr.substr(0, endor(curstr, '#'));
-			while (!params.empty()) {
-				const auto pair = params.substr(0, endor(params, '&'));
-				if (const auto eq = pair.find('='); eq != std::string_view::npos) {
-					query.emplace(pair.substr(0, eq), pair.substr(eq + 1));
-				}
-				else {
-					query.emplace(pair, std::string {});
+		if (port) {
+			const auto schemeEnd = out.find(':');
+			if (std::none_of(DEFAULT_PORTS.begin(), DEFAULT_PORTS.end(), [&out, schemeEnd, this](const auto & dp) {
+					return dp.second == *port && dp.first == std::string_view {out}.substr(0, schemeEnd);
+				})) {
+				out += ':';
+				out += std::to_string(*port);
+			}
+		}
+		if (path) {
+			std::string normalPath;
+			appendNormalised(normalPath, *path, keepPath);
+			appendPath(out, normalPath);
+		}
+		else {
+			out += '/';
+		}
+		if (query) {
+			std::vector<std::pair<std::string, std::string>> normalParams;
+			for (const auto & [name, value] : params()) {
+				if (name.empty() && value.empty()) {
+					continue;
 				}
-				params.remove_prefix(pair.length());
-				if (!params.empty()) {
-					params.remove_prefix(1);
+				auto & param = normalParams.emplace_back();
+				appendNormalised(param.first, name, keepQueryName);
+				appendNormalised(param.second, value, keepQueryValue);
+			}
+			std::stable_sort(normalParams.begin(), normalParams.end(), [](const auto & a, const auto & b) {
+				return a.first < b.first;
+			});
+			char sep = '?';
+			for (const auto & [name, value] : normalParams) {
+				out += std::exchange(sep, '&');
+				out += name;
+				if (!value.empty()) {
+					out += '=';
+					out += value;
 				}
 			}
 		}
+		if (fragment) {
+			out += '#';
+			appendNormalised(out, *fragment, keepFragment);
+		}
+	}
 
-		if (curstr.starts_with('#')) {
-			curstr.remove_prefix(1);
-			fragment = curstr;
+	std::string
+	UriView::decode(std::string_view in)
+	{
+		std::string out;
+		out.reserve(in.length());
+		while (!in.empty()) {
+			const auto run = endor(in, '%');
+			out.append(in.substr(0, run));
+			in.remove_prefix(run);
+			if (in.empty()) {
+				break;
+			}
+			if (const auto c = escaped(in)) {
+				out += *c;
+				in.remove_prefix(3);
+			}
+			else {
+				out += in.front();
+				in.remove_prefix(1);
+			}
+		}
+		return out;
+	}
+
+	UriView::QueryParams
+	UriView::params() const noexcept
+	{
+		return {query.value_or(std::string_view {})};
+	}
+
+	std::optional<std::string_view>
+	UriView::param(std::string_view name) const noexcept
+	{
+		for (const auto & [n, v] : params()) {
+			if (n == name) {
+				return v;
+			}
+		}
+		return {};
+	}
+
+	UriView::QueryIterator::QueryIterator(std::string_view q) : rest {q}, more {!q.empty()}
+	{
+		next();
+	}
+
+	void
+	UriView::QueryIterator::next()
+	{
+		if (!more) {
+			done = true;
+			return;
+		}
+		done = false;
+		const auto pair = rest.substr(0, endor(rest, '&'));
+		if (const auto eq = pair.find('='); eq != std::string_view::npos) {
+			current = {pair.substr(0, eq), pair.substr(eq + 1)};
+		}
+		else {
+			current = {pair, {}};
+		}
+		rest.remove_prefix(pair.length());
+		if (!rest.empty()) {
+			rest.remove_prefix(1);
+		}
+		more = !rest.empty();
+	}
+
+	const UriView::QueryIterator::value_type &
+	UriView::QueryIterator::operator*() const
+	{
+		return current;
+	}
+
+	const UriView::QueryIterator::value_type *
+	UriView::QueryIterator::operator->() const
+	{
+		return &current;
+	}
+
+	UriView::QueryIterator &
+	UriView::QueryIterator::operator++()
+	{
+		next();
+		return *this;
+	}
+
+	UriView::QueryIterator
+	UriView::QueryIterator::operator++(int)
+	{
+		auto prev = *this;
+		next();
+		return prev;
+	}
+
+	bool
+	UriView::QueryIterator::operator==(const QueryIterator & other) const
+	{
+		return done == other.done && (done || (rest.data() == other.rest.data() && more == other.more));
+	}
+
+	Uri::Uri(const std::string & uri) : Uri {UriView {uri}} { }
+
+	Uri::Uri(const UriView & uri) :
+		scheme {toLower(uri.scheme)}, username {uri.username}, password {uri.password}, host {toLower(uri.host)},
+		port {uri.port}, path {uri.path}, fragment {uri.fragment}
+	{
+		for (const auto & [name, value] : uri.params()) {
+			query.emplace(name, value);
 		}
 	}
 
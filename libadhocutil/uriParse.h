@@ -2,14 +2,147 @@
 
 #include "exception.h"
 #include "visibility.h"
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <map>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace AdHoc {
+	/**
+	 * Class representing a broken down URI as views of the source string, which must outlive it.
+	 * Components are exactly as they appear in the source; nothing is copied, decoded or case folded.
+	 */
+	class DLL_PUBLIC UriView {
+	public:
+		/// Reasons for failing to parse a URI.
+		enum class Error : uint8_t {
+			None,
+			NoSchemeMarker,
+			BadScheme,
+			NoSlashes,
+			NoHost,
+			UnterminatedIpv6,
+			BlankHost,
+			NoPort,
+			BadPort,
+			InvalidCharacter,
+			BadEscape,
+		};
+
+		/// Iterator over the name/value pairs of a query string.
+		class DLL_PUBLIC QueryIterator {
+		public:
+			/// The name/value pair.
+			using value_type = std::pair<std::string_view, std::string_view>;
+			/// Standard iterator difference type.
+			using difference_type = std::ptrdiff_t;
+
+			/// End iterator.
+			QueryIterator() = default;
+			/// Iterator over the given query string.
+			explicit QueryIterator(std::string_view query);
+
+			/// Get the current name/value pair.
+			const value_type & operator*() const;
+			/// Get the current name/value pair.
+			const value_type * operator->() const;
+			/// Move to the next name/value pair.
+			QueryIterator & operator++();
+			/// Move to the next name/value pair.
+			QueryIterator operator++(int);
+			/// Compare iterators (only meaningful for end).
+			bool operator==(const QueryIterator &) const;
+
+		private:
+			void next();
+
+			std::string_view rest;
+			value_type current;
+			bool more {false};
+			bool done {true};
+		};
+
+		/// Range of the name/value pairs of a query string.
+		struct QueryParams {
+			/// Start of the range.
+			[[nodiscard]] QueryIterator
+			begin() const
+			{
+				return QueryIterator {query};
+			}
+
+			/// End of the range.
+			[[nodiscard]] static QueryIterator
+			end()
+			{
+				return {};
+			}
+
+			/// The query string.
+			std::string_view query;
+		};
+
+		/// Construct an empty view, for use with parse().
+		UriView() = default;
+		/// Constructor accepting a URI to parse, throwing InvalidUri on failure.
+		/// @param uri the URI to parse.
+		explicit UriView(std::string_view uri);
+
+		/**
+		 * Parse a URI into this view, without throwing.
+		 * @param uri the URI to parse.
+		 * @return Error::None on success, otherwise the reason for failure (the view is then incomplete).
+		 */
+		[[nodiscard]] Error parse(std::string_view uri) noexcept;
+		/// Get a description of a parse error.
+		[[nodiscard]] static const char * describe(Error) noexcept;
+
+		/**
+		 * Check each component contains only the characters RFC 3986 permits there, and that any percent
+		 * escapes are well formed. Parsing alone is more lenient.
+		 * @return Error::None if valid, otherwise the first problem found.
+		 */
+		[[nodiscard]] Error validate() const noexcept;
+		/**
+		 * Get the normalised form of the URI, such that equivalent URIs compare equal (e.g. as cache keys).
+		 * The scheme and host are lowercased, percent escapes of unreserved characters are decoded and all
+		 * others uppercased, characters not permitted are escaped, a default port is dropped, dot segments are
+		 * removed from the path and query parameters are (stably) sorted by name.
+		 */
+		[[nodiscard]] std::string normalise() const;
+		/// As normalise(), replacing the contents of the given buffer to avoid allocating.
+		void normalise(std::string & out) const;
+		/// Percent-decode a component; malformed escapes are left as they are.
+		[[nodiscard]] static std::string decode(std::string_view);
+
+		/// Get the name/value pairs of the query string, split on demand.
+		[[nodiscard]] QueryParams params() const noexcept;
+		/// Get the value of the first query parameter with the given name.
+		[[nodiscard]] std::optional<std::string_view> param(std::string_view name) const noexcept;
+
+		/// The scheme.
+		std::string_view scheme;
+		/// The optional username.
+		std::optional<std::string_view> username;
+		/// The optional password.
+		std::optional<std::string_view> password;
+		/// The host.
+		std::string_view host;
+		/// The optional port.
+		std::optional<uint16_t> port;
+		/// The optional path (without leading /).
+		std::optional<std::string_view> path;
+		/// The optional query string (without leading ?).
+		std::optional<std::string_view> query;
+		/// The optional fragment.
+		std::optional<std::string_view> fragment;
+	};
+
 	/**
 	 * Class representing a broken down URI.
 	 */
@@ -18,6 +151,9 @@ namespace AdHoc {
 		/// Constructor accepting a URI to parse.
 		/// @param uri the URI to parse.
 		explicit Uri(const std::string & uri);
+		/// Constructor accepting a parsed URI view; the scheme and host are lowercased.
+		/// @param uri the parsed URI.
+		explicit Uri(const UriView & uri);
 
 		/// The scheme.
 		std::string scheme;